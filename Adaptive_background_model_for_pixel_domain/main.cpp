@@ -11,115 +11,29 @@
 #include <opencv2/highgui.hpp>
 
 #include "vibe-background-sequential.h"
+#include "vibe-background-parallel.h"
+#include "vibe-pyramid.h"
+#include "vibe-evaluation.h"
 #include <sys/types.h>
+#include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
 #include <vector>
 #include <string>
 #include <algorithm>    // std::sort
 #include <fstream>
+#include <cstdio>
+#include <cstring>
 
 using namespace cv;
 using namespace std;
 
 
-int ground_truth[2000][3000];
-int result[2000][3000];
-int H = 0;
-int W = 0;
-
-int TP_corvalue = 0;
-int TP_pos = 0;
-
-int FP_corvalue = 0;
-int FP_pos = 0;
-
-int TN_corvalue = 0;
-int TN_pos = 0;
-
-int FN_corvalue = 0;
-int FN_pos = 0;
-
-float TruePositive()
-{
-	for (int i = 0; i < H; i++)
-	{
-		for (int j = 0; j < W; j++)
-		{
-			if (ground_truth[i][j] != 0 && ground_truth[i][j] != 85)
-			{
-				TP_pos ++;
-				if (result[i][j] != 0 && result[i][j] != 85)
-					TP_corvalue ++;
-			}
-		}
-	}
-	if (TP_pos == 0)
-	{
-		return 1;
-	}
-		
-	return ((float)TP_corvalue) / TP_pos;
-}
-
-float FalsePositive()
-{
-	for (int i = 0; i < H; i++)
-	{
-		for (int j = 0; j < W; j++)
-		{
-			if (ground_truth[i][j] != 0 && ground_truth[i][j] != 85)
-			{
-				FP_pos++;
-				if (result[i][j] == 0 || result[i][j] == 85)
-					FP_corvalue++;
-			}
-		}
-	}
-	if (FP_pos == 0)
-	{
-		return 1;
-	}
-	return ((float)FP_corvalue) / FP_pos;
-}
-
-float TrueNegative()
-{
-	for (int i = 0; i < H; i++)
-	{
-		for (int j = 0; j < W; j++)
-		{
-			if (ground_truth[i][j] == 0 || ground_truth[i][j] == 85)
-			{
-				TN_pos++;
-				if (result[i][j] == 0 || result[i][j] == 85)
-					TN_corvalue++;
-			}
-		}
-	}
-	if (TN_pos == 0)
-		return 1;
-	return ((float)TN_corvalue) / TN_pos;
-}
-
-float FalseNegative()
-{
-	for (int i = 0; i < H; i++)
-	{
-		for (int j = 0; j < W; j++)
-		{
-			if (ground_truth[i][j] == 0 || ground_truth[i][j] == 85)
-			{
-				FN_pos++;
-				if (result[i][j] != 0 && result[i][j] != 0)
-					FN_corvalue++;
-			}
-		}
-	}
-	if (FN_pos == 0)
-		return 1;
-	return ((float)FN_corvalue) / FN_pos;
-}
+/* Ground truth of the current frame, one byte per pixel, and the confusion counts of the frame and
+   of all the frames so far. */
+Mat groundTruth;
+vibeConfusion_t frameConfusion;
+vibeConfusion_t totalConfusion = { 0, 0, 0, 0, 0 };
 
 bool myComparefunc (string i,string j)
 {
@@ -158,12 +72,43 @@ void help()
     << "--------------------------------------------------------------------------" << endl
     << "This program shows how to use ViBe with OpenCV                            " << endl
     << "Usage:"                                                                     << endl
-    << "./main-opencv <video filename>"                                             << endl
+    << "./main-opencv <image directory> [ground truth directory]"                   << endl
+    << "./main-opencv <video.yuv> <width>x<height> [ground truth directory]"       << endl
     << "for example: ./main-opencv video.avi"                                       << endl
+    << "A .yuv file holds raw I420 frames, read without any color conversion"      << endl
     << "--------------------------------------------------------------------------" << endl
     << endl;
 }
 bool needTest = false;
+/* Memory layout of the ViBe model: interleaved BGR (C3R), planar BGR (P3R) with SIMD matching,
+   YUV420 planes matched at their native resolution, or a C3R pyramid that only matches the full
+   resolution pixels around the foreground of a 1/4 scale model, or C3R with samples quantized to
+   5 bits per channel (83 MB instead of 124 MB at 1080p). */
+enum ModelLayout { LAYOUT_C3R, LAYOUT_P3R, LAYOUT_YUV420, LAYOUT_PYRAMID, LAYOUT_PACKED };
+ModelLayout modelLayout = LAYOUT_P3R;
+/* Threads running the C3R model strip by strip, 0 for one per core and 1 for the sequential code. */
+int numberOfThreads = 0;
+/* Side of the tiles refined at full resolution by the pyramid. */
+int pyramidTileSize = 16;
+/* Size of the frames of a raw I420 (.yuv) input, 0 for a directory of images. Raw frames go
+   straight into the planes of the YUV420 layout; the other layouts convert them to BGR. */
+int yuvWidth = 0;
+int yuvHeight = 0;
+
+/* 5x5 median filter of the rows [y0, y1) of src into dst, reading 2 rows of halo above and below. */
+struct MedianStrip { Mat src; Mat dst; };
+
+static void median_strip(void *arg, uint32_t y0, uint32_t y1)
+{
+  MedianStrip *strip = (MedianStrip*)arg;
+  int top = max((int)y0 - 2, 0);
+  int bottom = min((int)y1 + 2, strip->src.rows);
+  Mat blurred;
+  Mat rows = strip->dst.rowRange(y0, y1);
+
+  medianBlur(strip->src.rowRange(top, bottom), blurred, 5);
+  blurred.rowRange(y0 - top, y1 - top).copyTo(rows);
+}
 
 /**
  * Main program. It shows how to use the grayscale version (C1R) and the RGB version (C3R). 
@@ -180,10 +125,20 @@ int main(int argc, char* argv[])
 		return EXIT_FAILURE;
 	}
 	char* gtdir = argv[1]; //just for init
-	if (argc == 3)
+	int gtarg = 2;
+	size_t length = strlen(argv[1]);
+	if (length > 4 && strcmp(argv[1] + length - 4, ".yuv") == 0)
+	{
+		if (argc < 3 || sscanf(argv[2], "%dx%d", &yuvWidth, &yuvHeight) != 2 || yuvWidth <= 0 || yuvHeight <= 0) {
+			cerr << "Raw I420 input needs the frame size, as <width>x<height>" << endl;
+			return EXIT_FAILURE;
+		}
+		gtarg = 3;
+	}
+	if (argc == gtarg + 1)
 	{
 		needTest = true;
-		gtdir = argv[2];
+		gtdir = argv[gtarg];
 	}
 
 
@@ -210,7 +165,12 @@ void processVideo(char* videoFilename, char* gtdir)
 	
 	vector<string> files = vector<string>();
 
-	getdir(dir,files);
+	bool rawInput = (yuvWidth > 0);
+	ifstream yuvFile;
+	if (rawInput)
+		yuvFile.open(videoFilename, ios::binary);
+	else
+		getdir(dir,files);
 
 
 	string groundtruth_dir = string(gtdir);
@@ -237,10 +197,17 @@ void processVideo(char* videoFilename, char* gtdir)
   static int frameNumber = 1; /* The current frame number */
   Mat frame;                  /* Current frame. */
   Mat segmentationMap;        /* Will contain the segmentation map. This is the binary output map. */
+  Mat planar;                 /* Current frame as three planes, for the P3R model. */
+  Mat i420;                   /* Current frame as YUV420 planes, read from a raw input or converted. */
+  vector<Mat> planes;         /* The three planes of planar. */
+  vibeImage_YUV420_t yuv;     /* Planes of the YUV420 frame. */
   int keyboard = 0;           /* Input from keyboard. Used to stop the program. Enter 'q' to quit. */
 
   /* Model for ViBe. */
   vibeModel_Sequential_t *model = NULL; /* Model used by ViBe. */
+  vibeParallel_t *pool = NULL;          /* Threads for the C3R model. */
+  vibePyramid_t *pyramid = NULL;        /* Coarse and fine models of the pyramid. */
+  MedianStrip median;                   /* Arguments of the parallel median filter. */
 
   /* Read input data. ESC or 'q' for quitting. */
   int frame_index = 2;
@@ -252,9 +219,11 @@ void processVideo(char* videoFilename, char* gtdir)
     //  exit(EXIT_FAILURE);
     //}
     string image_path = videoFilename;
-    if(image_path.at(image_path.length()-1) != '/')
-    	image_path.append("/");
-    image_path.append(files[frame_index]);
+    if (!rawInput) {
+      if(image_path.at(image_path.length()-1) != '/')
+      	image_path.append("/");
+      image_path.append(files[frame_index]);
+    }
 
     string groundtruth_path = gtdir;
     if (needTest)
@@ -268,9 +237,19 @@ void processVideo(char* videoFilename, char* gtdir)
     if (needTest)
     	cout << "    vs    " << groundtruth_path;
     cout << endl;
-  	frame = imread(image_path, CV_LOAD_IMAGE_COLOR);
-  	H = frame.rows;
-  	W = frame.cols;
+    if (rawInput) {
+      if (i420.empty())
+        i420 = Mat(yuvHeight * 3 / 2, yuvWidth, CV_8UC1);
+      if (!yuvFile.read((char*)i420.data, i420.total()))
+        break;
+      /* The YUV420 layout shows the luma plane; the other layouts need BGR. */
+      if (modelLayout == LAYOUT_YUV420)
+        frame = i420.rowRange(0, yuvHeight);
+      else
+        cvtColor(i420, frame, COLOR_YUV2BGR_I420);
+    }
+    else
+      frame = imread(image_path, CV_LOAD_IMAGE_COLOR);
   	if(! frame.data )                              // Check for invalid input
     {
         cerr << "Unable to read next frame." << endl;
@@ -288,51 +267,113 @@ void processVideo(char* videoFilename, char* gtdir)
      */
     /* cvtColor(frame, frame, CV_BGR2GRAY); */
 
+    if (modelLayout == LAYOUT_P3R) {
+      if (frameNumber == 1) {
+        planar = Mat(3 * frame.rows, frame.cols, CV_8UC1);
+        for (int c = 0; c < 3; c++)
+          planes.push_back(planar.rowRange(c * frame.rows, (c + 1) * frame.rows));
+      }
+      split(frame, planes);
+    }
+    else if (modelLayout == LAYOUT_YUV420) {
+      /* Raw frames are already I420. Image files are BGR and cost one conversion per frame. */
+      if (!rawInput)
+        cvtColor(frame, i420, COLOR_BGR2YUV_I420);
+      yuv.y = i420.data;
+      yuv.u = yuv.y + frame.rows * frame.cols;
+      yuv.v = yuv.u + (frame.rows / 2) * (frame.cols / 2);
+      yuv.yStride = frame.cols;
+      yuv.uvStride = frame.cols / 2;
+    }
+
     if (frameNumber == 1) {
       segmentationMap = Mat(frame.rows, frame.cols, CV_8UC1);
-      model = (vibeModel_Sequential_t*)libvibeModel_Sequential_New();
-      libvibeModel_Sequential_AllocInit_8u_C3R(model, frame.data, frame.cols, frame.rows);
+      /* The pyramid holds its own models. */
+      if (modelLayout != LAYOUT_PYRAMID)
+        model = (vibeModel_Sequential_t*)libvibeModel_Sequential_New();
+      if (modelLayout == LAYOUT_PYRAMID) {
+        pyramid = libvibePyramid_New(pyramidTileSize);
+        libvibePyramid_AllocInit_8u_C3R(pyramid, frame.data, frame.cols, frame.rows);
+      }
+      else if (modelLayout == LAYOUT_PACKED)
+        libvibeModel_Sequential_AllocInit_8u_C3R_Packed(model, frame.data, frame.cols, frame.rows);
+      else if (modelLayout == LAYOUT_P3R)
+        libvibeModel_Sequential_AllocInit_8u_P3R(model, planar.data, frame.cols, frame.rows);
+      else if (modelLayout == LAYOUT_YUV420)
+        libvibeModel_Sequential_AllocInit_8u_YUV420(model, &yuv, frame.cols, frame.rows);
+      else
+        libvibeModel_Sequential_AllocInit_8u_C3R(model, frame.data, frame.cols, frame.rows);
+
+      int threads = (numberOfThreads > 0) ? numberOfThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+      if ((modelLayout == LAYOUT_C3R) && (threads > 1)) {
+        pool = libvibeParallel_New(model, threads, 0);
+        median.src = Mat(frame.rows, frame.cols, CV_8UC1);
+        median.dst = segmentationMap;
+      }
     }
 
     /* ViBe: Segmentation and updating. */
-    libvibeModel_Sequential_Segmentation_8u_C3R(model, frame.data, segmentationMap.data);
-    libvibeModel_Sequential_Update_8u_C3R(model, frame.data, segmentationMap.data);
+    if (modelLayout == LAYOUT_P3R) {
+      libvibeModel_Sequential_Segmentation_8u_P3R(model, planar.data, segmentationMap.data);
+      libvibeModel_Sequential_Update_8u_P3R(model, planar.data, segmentationMap.data);
+    }
+    else if (modelLayout == LAYOUT_YUV420) {
+      libvibeModel_Sequential_Segmentation_8u_YUV420(model, &yuv, segmentationMap.data);
+      libvibeModel_Sequential_Update_8u_YUV420(model, &yuv, segmentationMap.data);
+    }
+    else if (modelLayout == LAYOUT_PACKED) {
+      libvibeModel_Sequential_Segmentation_8u_C3R_Packed(model, frame.data, segmentationMap.data);
+      libvibeModel_Sequential_Update_8u_C3R_Packed(model, frame.data, segmentationMap.data);
+    }
+    else if (modelLayout == LAYOUT_PYRAMID) {
+      libvibePyramid_Process_8u_C3R(pyramid, frame.data, segmentationMap.data);
+      if ((frameNumber % 100) == 0)
+        cout << "Tiles refined: " << libvibePyramid_GetActiveTiles(pyramid) << " / " << libvibePyramid_GetNumberOfTiles(pyramid) << endl;
+    }
+    else if (pool != NULL) {
+      libvibeParallel_Segmentation_8u_C3R(pool, frame.data, segmentationMap.data);
+      libvibeParallel_Update_8u_C3R(pool, frame.data, segmentationMap.data);
+    }
+    else {
+      libvibeModel_Sequential_Segmentation_8u_C3R(model, frame.data, segmentationMap.data);
+      libvibeModel_Sequential_Update_8u_C3R(model, frame.data, segmentationMap.data);
+    }
 
     /* Post-processes the segmentation map. This step is not compulsory. 
        Note that we strongly recommend to use post-processing filters, as they 
        always smooth the segmentation map. For example, the post-processing filter 
        used for the Change Detection dataset (see http://www.changedetection.net/ ) 
        is a 5x5 median filter. */
-    medianBlur(segmentationMap, segmentationMap, 5); /* 3x3 median filtering */
+    if (pool != NULL) {
+      /* The strips read the unfiltered map, so it is copied first. */
+      segmentationMap.copyTo(median.src);
+      libvibeParallel_ForEachStrip(pool, median_strip, &median);
+    }
+    else
+      medianBlur(segmentationMap, segmentationMap, 5); /* 3x3 median filtering */
 
     if (needTest)
     {
-	    for (int i = 0; i < H ; i++)
-		{
-			for (int j = 0; j < W; j++)
-			{
-				int index = i*W + j;
-				result[i][j] = segmentationMap.data[index];
-			}
-		}
+		if (groundTruth.rows != frame.rows || groundTruth.cols != frame.cols)
+			groundTruth = Mat(frame.rows, frame.cols, CV_8UC1);
 
 		ifstream gt_fin;
 		gt_fin.open(groundtruth_path.c_str());
-		for (int i = 0; i < H ; i++)
+		for (int index = 0; index < frame.rows * frame.cols; index++)
 		{
-			for (int j = 0; j < W; j++)
-			{
-				gt_fin >> ground_truth[i][j];
-			}
+			int value = 0;
+			gt_fin >> value;
+			groundTruth.data[index] = value;
 		}
-		float tp = TruePositive();
-		float fp = FalsePositive();
-		//float tn = TrueNegative();
-		float fn = FalseNegative();
-
-		float recall = tp / (tp + fp);
-		float precision = tp / (tp + fn);
-		cout << "Recall: " << recall << "    vs    Precision: " << precision << endl;
+
+		/* One pass over both maps counts the four classes and the unknown pixels. */
+		libvibeEvaluation_Count_8u_C1R(&frameConfusion, groundTruth.data, segmentationMap.data, frame.cols, frame.rows);
+		libvibeEvaluation_Add(&totalConfusion, &frameConfusion);
+
+		cout << "Recall: " << libvibeEvaluation_Recall(&frameConfusion)
+		     << "    vs    Precision: " << libvibeEvaluation_Precision(&frameConfusion)
+		     << "    (cumulative " << libvibeEvaluation_Recall(&totalConfusion)
+		     << " vs " << libvibeEvaluation_Precision(&totalConfusion) << ")" << endl;
     }
 	
 
@@ -347,9 +388,16 @@ void processVideo(char* videoFilename, char* gtdir)
     keyboard = waitKey(1);
   }
 
+  if (needTest)
+    cout << "TP " << totalConfusion.truePositives << "  FP " << totalConfusion.falsePositives
+         << "  TN " << totalConfusion.trueNegatives << "  FN " << totalConfusion.falseNegatives
+         << "  unknown " << totalConfusion.unknown << endl;
+
   /* Delete capture object. */
   //capture.release();
 
   /* Frees the model. */
+  libvibeParallel_Free(pool);
+  libvibePyramid_Free(pyramid);
   libvibeModel_Sequential_Free(model);
 }
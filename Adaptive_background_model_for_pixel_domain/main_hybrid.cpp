@@ -0,0 +1,243 @@
+/**
+ * @file main_hybrid.cpp
+ * @brief Compressed-domain gating of the pixel-domain ViBe
+ *
+ * The block-grid model of ../Background_model_by_motion_vector_H264 runs on the
+ * bitsize and motion vectors of every frame and nominates the macroblocks that
+ * hold foreground. Only these macroblocks, plus a margin, are matched by the
+ * C3R model at full resolution. The C3R model of the other macroblocks is
+ * refreshed lazily, a few rows of macroblocks per frame.
+ *
+ * The JM feature files are read and the motion vectors quantized by the same
+ * JmReader and MvQuantizer as the H264 program. Built by "make hybrid" in
+ * ../Background_model_by_motion_vector_H264.
+ */
+#include <iostream>
+
+#include "opencv2/imgproc.hpp"
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/highgui.hpp>
+
+#include "vibe-background-sequential.h"
+#include "../Background_model_by_motion_vector_H264/vibe-block-sequential.h"
+#include "../Background_model_by_motion_vector_H264/JmReader.h"
+#include "../Background_model_by_motion_vector_H264/MvQuantizer.h"
+
+using namespace cv;
+using namespace std;
+
+/** Function Headers */
+void help();
+void processVideo(char* videoFilename);
+
+// Compressed-domain features, on the grid of 4x4 pixel blocks (bit: one value per macroblock).
+const int max_width = 1000;
+const int max_height = 1000;
+JmReader jm;
+MvQuantizer quantizer;
+int bit[max_height][max_width];
+int type[max_height][max_width];
+double mv_x[max_height][max_width];
+double mv_y[max_height][max_width];
+
+const int mb_size = 16;   /* Pixels per side of a macroblock. */
+int margin_mbs = 1;       /* Macroblocks around the nominated ones that are matched too. */
+int refresh_period = 8;   /* Idle macroblocks are updated once every refresh_period frames. */
+
+void help()
+{
+    cout
+    << "--------------------------------------------------------------------------" << endl
+    << "Pixel-domain ViBe gated by the motion vectors and bitsize of the stream   " << endl
+    << "Usage:"                                                                     << endl
+    << "./main_hybrid <video filename> <MV file> <BitSize file>"                   << endl
+    << "--------------------------------------------------------------------------" << endl
+    << endl;
+}
+
+/**
+ * Main program.
+ */
+int main(int argc, char* argv[])
+{
+  /* Print help information. */
+  help();
+
+  /* Check for the input parameter correctness. */
+  if (argc < 4) {
+    cerr <<"Incorrect input" << endl;
+    cerr <<"exiting..." << endl;
+    return EXIT_FAILURE;
+  }
+
+  /* Create GUI windows. */
+  namedWindow("Frame");
+  namedWindow("Segmentation");
+  namedWindow("Active macroblocks");
+
+  if (!jm.open(argv[2], argv[3])) {
+    cerr << "Unable to open the MV or BitSize file" << endl;
+    return EXIT_FAILURE;
+  }
+
+  processVideo(argv[1]);
+
+  jm.close();
+
+  /* Destroy GUI windows. */
+  destroyAllWindows();
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Processes the video.
+ *
+ * @param videoFilename  The name of the input video file.
+ */
+void processVideo(char* videoFilename)
+{
+  /* Create the capture object. */
+  VideoCapture capture(videoFilename);
+
+  if (!capture.isOpened()) {
+    /* Error in opening the video input. */
+    cerr << "Unable to open video file: " << videoFilename << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  /* Variables. */
+  static int frameNumber = 1; /* The current frame number */
+  Mat frame;                  /* Current decoded frame. */
+  Mat segmentationMap;        /* Full resolution binary output map. */
+  Mat blockMap;               /* Output of the block-grid model. */
+  Mat activeMap;              /* One byte per macroblock, non zero when it is matched in the pixel domain. */
+  Mat blockBits, blockMotion, blockDirection; /* Feature planes of the block-grid model. */
+  int keyboard = 0;           /* Input from keyboard. Used to stop the program. Enter 'q' to quit. */
+
+  /* Grid of 4x4 blocks of the feature files. */
+  int height, width;
+  jm.read_size(width, height);
+
+  blockMap = Mat(height, width, CV_8UC1);
+  blockBits = Mat(height, width, CV_16UC1);
+  blockMotion = Mat(height, width, CV_16UC1);
+  blockDirection = Mat(height, width, CV_8UC1);
+  vibeBlockFeatures_t features = { (uint16_t*)blockBits.data, (uint16_t*)blockMotion.data, blockDirection.data };
+
+  /* Models. */
+  vibeModel_Block_t *blockModel = NULL;  /* Block-grid model nominating the macroblocks. */
+  vibeModel_Sequential_t *model = NULL;  /* Pixel-domain model. */
+  uint32_t seed = 2 * (uint32_t)rand() + 1;
+
+  int mbRows = 0, mbCols = 0;
+  long long matchedPixels = 0, totalPixels = 0;
+
+  /* Read input data. ESC or 'q' for quitting. */
+  while ((char)keyboard != 'q' && (char)keyboard != 27) {
+    /* Read the current frame. */
+    if (!capture.read(frame)) {
+      cerr << "Unable to read next frame." << endl;
+      break;
+    }
+
+    if ((frameNumber % 100) == 0) { cout << "Frame number = " << frameNumber << endl; }
+
+    /* Compressed-domain stage. */
+    if (!jm.read_frame(height/4, width/4, &bit[0][0], &type[0][0], max_width, &mv_x[0][0], &mv_y[0][0], max_width)) {
+      cerr << "Unable to read the features of the frame." << endl;
+      break;
+    }
+
+    for (int i=0;i<height;i++){
+      quantizer.quantize(mv_x[i], mv_y[i], width, blockDirection.data + i*width, (uint16_t*)blockMotion.data + i*width);
+      for (int j=0;j<width;j++)
+        ((uint16_t*)blockBits.data)[i*width+j] = bit[i/4][j/4];
+    }
+
+    if (frameNumber == 1) {
+      blockModel = libvibeModel_Block_New();
+      libvibeModel_Block_AllocInit(blockModel, &features, width, height);
+
+      segmentationMap = Mat(frame.rows, frame.cols, CV_8UC1);
+      model = (vibeModel_Sequential_t*)libvibeModel_Sequential_New();
+      libvibeModel_Sequential_AllocInit_8u_C3R(model, frame.data, frame.cols, frame.rows);
+
+      mbRows = (frame.rows + mb_size - 1) / mb_size;
+      mbCols = (frame.cols + mb_size - 1) / mb_size;
+      activeMap = Mat(mbRows, mbCols, CV_8UC1);
+    }
+
+    libvibeModel_Block_Segmentation(blockModel, &features, blockMap.data);
+    libvibeModel_Block_Update(blockModel, &features, blockMap.data);
+
+    /* Macroblocks with a foreground 4x4 block, dilated by margin_mbs. The feature grid
+       may be cropped with respect to the frame: macroblocks out of it stay idle. */
+    memset(activeMap.data, 0, mbRows * mbCols);
+    for (int i=0;i<height;i++)
+      for (int j=0;j<width;j++){
+        if (blockMap.data[i*width+j] == COLOR_BACKGROUND) continue;
+
+        int mbi = i/4, mbj = j/4;
+        for (int u = max(mbi - margin_mbs, 0); u <= min(mbi + margin_mbs, mbRows - 1); u++)
+          for (int v = max(mbj - margin_mbs, 0); v <= min(mbj + margin_mbs, mbCols - 1); v++)
+            activeMap.data[u*mbCols+v] = 255;
+      }
+
+    /* Pixel-domain stage, on runs of macroblocks with the same state. The first pass matches
+       the active macroblocks and sets the idle ones to background, the second one updates the
+       active macroblocks and the idle rows due for a refresh. As with the full frame functions,
+       the whole map is known before the neighbors of a macroblock are updated. */
+    for (int pass = 0; pass < 2; pass++)
+      for (int mbi = 0; mbi < mbRows; mbi++) {
+        uint32_t y0 = mbi * mb_size;
+        uint32_t y1 = min((mbi + 1) * mb_size, frame.rows);
+        bool refresh = (mbi % refresh_period) == (frameNumber % refresh_period);
+        int mbj = 0;
+
+        while (mbj < mbCols) {
+          int first = mbj;
+          uint8_t active = activeMap.data[mbi*mbCols+mbj];
+          while (mbj < mbCols && activeMap.data[mbi*mbCols+mbj] == active) mbj++;
+
+          uint32_t x0 = first * mb_size;
+          uint32_t x1 = min(mbj * mb_size, frame.cols);
+
+          if (pass == 0 && active) {
+            libvibeModel_Sequential_SegmentationTile_8u_C3R(model, frame.data, segmentationMap.data, x0, y0, x1, y1);
+            matchedPixels += (x1 - x0) * (y1 - y0);
+          }
+          else if (pass == 0) {
+            for (uint32_t y = y0; y < y1; y++)
+              memset(segmentationMap.data + y * frame.cols + x0, COLOR_BACKGROUND, x1 - x0);
+          }
+          else if (active || refresh)
+            libvibeModel_Sequential_UpdateTile_8u_C3R(model, frame.data, segmentationMap.data, x0, y0, x1, y1, &seed);
+        }
+      }
+    totalPixels += frame.rows * frame.cols;
+
+    if ((frameNumber % 100) == 0)
+      cout << "Pixels matched: " << (100.0 * matchedPixels / totalPixels) << " %" << endl;
+
+    /* Post-processes the segmentation map, as the pixel-domain main does. */
+    medianBlur(segmentationMap, segmentationMap, 5);
+
+    /* Shows the current frame and the segmentation map. */
+    imshow("Frame", frame);
+    imshow("Segmentation", segmentationMap);
+    imshow("Active macroblocks", activeMap);
+
+    ++frameNumber;
+
+    /* Gets the input from the keyboard. */
+    keyboard = waitKey(1);
+  }
+
+  /* Delete capture object. */
+  capture.release();
+
+  /* Frees the models. */
+  libvibeModel_Sequential_Free(model);
+  libvibeModel_Block_Free(blockModel);
+}
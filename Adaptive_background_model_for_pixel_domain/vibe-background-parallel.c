@@ -0,0 +1,275 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "vibe-background-parallel.h"
+
+typedef enum
+{
+  TASK_SEGMENTATION,
+  TASK_UPDATE,
+  TASK_JOB
+} vibeParallelTask_t;
+
+typedef struct
+{
+  uint32_t y0;
+  uint32_t y1;
+  uint32_t seed;
+} vibeParallelStrip_t;
+
+struct vibeParallel
+{
+  vibeModel_Sequential_t *model;
+  uint32_t width;
+
+  /* Strips of the image. */
+  vibeParallelStrip_t *strips;
+  uint32_t numberOfStrips;
+
+  /* Threads, the calling thread is not part of them. */
+  pthread_t *threads;
+  uint32_t numberOfWorkers;
+
+  /* Current task, protected by lock. */
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t finished;
+  uint64_t generation;
+  int quit;
+
+  vibeParallelTask_t task;
+  const uint8_t *image_data;
+  uint8_t *map;
+  vibeParallelJob_t job;
+  void *arg;
+
+  /* Strips next, next + step, ... up to numberOfStrips are handed out one by one. */
+  uint32_t next;
+  uint32_t step;
+  uint32_t pending;
+};
+
+// -----------------------------------------------------------------------------
+// Runs the current task on one strip
+// -----------------------------------------------------------------------------
+static void run_strip(vibeParallel_t *pool, vibeParallelStrip_t *strip)
+{
+  switch (pool->task) {
+    case TASK_SEGMENTATION:
+      libvibeModel_Sequential_SegmentationTile_8u_C3R(
+        pool->model, pool->image_data, pool->map, 0, strip->y0, pool->width, strip->y1);
+      break;
+    case TASK_UPDATE:
+      libvibeModel_Sequential_UpdateTile_8u_C3R(
+        pool->model, pool->image_data, pool->map, 0, strip->y0, pool->width, strip->y1, &strip->seed);
+      break;
+    case TASK_JOB:
+      pool->job(pool->arg, strip->y0, strip->y1);
+      break;
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Takes strips until none is left, called with the lock held
+// -----------------------------------------------------------------------------
+static void run_strips(vibeParallel_t *pool)
+{
+  while (pool->next < pool->numberOfStrips) {
+    vibeParallelStrip_t *strip = pool->strips + pool->next;
+    pool->next += pool->step;
+
+    pthread_mutex_unlock(&pool->lock);
+    run_strip(pool, strip);
+    pthread_mutex_lock(&pool->lock);
+
+    if (--pool->pending == 0)
+      pthread_cond_signal(&pool->finished);
+  }
+}
+
+static void *worker(void *data)
+{
+  vibeParallel_t *pool = (vibeParallel_t*)data;
+  uint64_t seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while ((pool->generation == seen) && !pool->quit)
+      pthread_cond_wait(&pool->start, &pool->lock);
+
+    if (pool->quit)
+      break;
+
+    seen = pool->generation;
+    run_strips(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return(NULL);
+}
+
+// -----------------------------------------------------------------------------
+// Runs the current task on the strips first, first + step, ... and waits for them
+// -----------------------------------------------------------------------------
+static void dispatch(vibeParallel_t *pool, const uint32_t first, const uint32_t step)
+{
+  if (first >= pool->numberOfStrips)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->next = first;
+  pool->step = step;
+  pool->pending = (pool->numberOfStrips - first + step - 1) / step;
+  ++pool->generation;
+  pthread_cond_broadcast(&pool->start);
+
+  /* The calling thread works too. */
+  run_strips(pool);
+
+  while (pool->pending > 0)
+    pthread_cond_wait(&pool->finished, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+// -----------------------------------------------------------------------------
+// Creates the pool
+// -----------------------------------------------------------------------------
+vibeParallel_t *libvibeParallel_New(
+  vibeModel_Sequential_t *model,
+  const uint32_t numberOfThreads,
+  const uint32_t numberOfStrips
+) {
+  assert(model != NULL);
+  assert(numberOfThreads > 0);
+
+  uint32_t width = libvibeModel_Sequential_GetWidth(model);
+  uint32_t height = libvibeModel_Sequential_GetHeight(model);
+  assert((width > 0) && (height > 0));
+
+  vibeParallel_t *pool = (vibeParallel_t*)calloc(1, sizeof(*pool));
+  assert(pool != NULL);
+
+  pool->model = model;
+  pool->width = width;
+
+  /* Strips of at least 2 rows: the halo row below an even strip and the one
+     above the next even strip then always belong to distinct rows. */
+  uint32_t strips = (numberOfStrips > 0) ? numberOfStrips : 4 * numberOfThreads;
+  if (strips > height / 2)
+    strips = (height / 2 > 0) ? height / 2 : 1;
+
+  pool->numberOfStrips = strips;
+  pool->strips = (vibeParallelStrip_t*)malloc(strips * sizeof(*(pool->strips)));
+  assert(pool->strips != NULL);
+
+  for (uint32_t i = 0; i < strips; ++i) {
+    pool->strips[i].y0 = (uint32_t)(((uint64_t)height * i) / strips);
+    pool->strips[i].y1 = (uint32_t)(((uint64_t)height * (i + 1)) / strips);
+    pool->strips[i].seed = 2 * (uint32_t)rand() + 1; // Never 0.
+  }
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->finished, NULL);
+
+  pool->numberOfWorkers = numberOfThreads - 1;
+  if (pool->numberOfWorkers > 0) {
+    pool->threads = (pthread_t*)malloc(pool->numberOfWorkers * sizeof(*(pool->threads)));
+    assert(pool->threads != NULL);
+
+    for (uint32_t i = 0; i < pool->numberOfWorkers; ++i) {
+      int error = pthread_create(pool->threads + i, NULL, worker, pool);
+      assert(error == 0);
+      (void)error;
+    }
+  }
+
+  return(pool);
+}
+
+// -----------------------------------------------------------------------------
+// Segmentation
+// -----------------------------------------------------------------------------
+int32_t libvibeParallel_Segmentation_8u_C3R(
+  vibeParallel_t *pool,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+) {
+  assert((pool != NULL) && (image_data != NULL) && (segmentation_map != NULL));
+
+  pool->task = TASK_SEGMENTATION;
+  pool->image_data = image_data;
+  pool->map = segmentation_map;
+  dispatch(pool, 0, 1);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Update
+// -----------------------------------------------------------------------------
+int32_t libvibeParallel_Update_8u_C3R(
+  vibeParallel_t *pool,
+  const uint8_t *image_data,
+  uint8_t *updating_mask
+) {
+  assert((pool != NULL) && (image_data != NULL) && (updating_mask != NULL));
+
+  pool->task = TASK_UPDATE;
+  pool->image_data = image_data;
+  pool->map = updating_mask;
+
+  /* Neighboring strips are never updated at the same time. */
+  dispatch(pool, 0, 2);
+  dispatch(pool, 1, 2);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Any work, strip by strip
+// -----------------------------------------------------------------------------
+int32_t libvibeParallel_ForEachStrip(
+  vibeParallel_t *pool,
+  vibeParallelJob_t job,
+  void *arg
+) {
+  assert((pool != NULL) && (job != NULL));
+
+  pool->task = TASK_JOB;
+  pool->job = job;
+  pool->arg = arg;
+  dispatch(pool, 0, 1);
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// Frees the pool
+// ----------------------------------------------------------------------------
+int32_t libvibeParallel_Free(vibeParallel_t *pool)
+{
+  if (pool == NULL)
+    return(-1);
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = 1;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (uint32_t i = 0; i < pool->numberOfWorkers; ++i)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->finished);
+  pthread_cond_destroy(&pool->start);
+  pthread_mutex_destroy(&pool->lock);
+
+  free(pool->threads);
+  free(pool->strips);
+  free(pool);
+
+  return(0);
+}
@@ -0,0 +1,102 @@
+#ifndef _VIBE_PARALLEL_H_
+#define _VIBE_PARALLEL_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "vibe-background-sequential.h"
+
+/**
+ * \typedef struct vibeParallel_t
+ * \brief Persistent pool of threads running a C3R model strip by strip.
+ *
+ * The image is cut into horizontal strips of whole rows. Every strip has its
+ * own random generator, and the update runs the even strips before the odd
+ * ones so that the neighbor written one row outside of a strip is never
+ * written by another thread at the same time.
+ */
+typedef struct vibeParallel vibeParallel_t;
+
+/**
+ * Work on the rows [y0, y1) of the image, see \ref libvibeParallel_ForEachStrip.
+ */
+typedef void (*vibeParallelJob_t)(void *arg, uint32_t y0, uint32_t y1);
+
+/**
+ * Creates the pool and starts its threads. The model must be initialized
+ * with \ref libvibeModel_Sequential_AllocInit_8u_C3R before.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param numberOfThreads Number of threads working on a frame, the calling thread included.
+ * @param numberOfStrips Number of strips of the image, 0 for 4 strips per thread. Strips
+ * have at least 2 rows, so the number is reduced for small images.
+ * \result A pointer to a newly allocated \ref vibeParallel_t structure.
+ */
+vibeParallel_t *libvibeParallel_New(
+  vibeModel_Sequential_t *model,
+  const uint32_t numberOfThreads,
+  const uint32_t numberOfStrips
+);
+
+/**
+ * Same result as \ref libvibeModel_Sequential_Segmentation_8u_C3R.
+ *
+ * @param pool
+ * @param image_data
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibeParallel_Segmentation_8u_C3R(
+  vibeParallel_t *pool,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+);
+
+/**
+ * Updates the model like \ref libvibeModel_Sequential_Update_8u_C3R, with the
+ * random numbers of the strips instead of rand().
+ *
+ * @param pool
+ * @param image_data
+ * @param updating_mask
+ * @return
+ */
+int32_t libvibeParallel_Update_8u_C3R(
+  vibeParallel_t *pool,
+  const uint8_t *image_data,
+  uint8_t *updating_mask
+);
+
+/**
+ * Runs job on every strip of the image with the threads of the pool and
+ * returns once all strips are done. Useful for post-processing the
+ * segmentation map with the same threads.
+ *
+ * @param pool
+ * @param job
+ * @param arg Passed to job as is.
+ * @return
+ */
+int32_t libvibeParallel_ForEachStrip(
+  vibeParallel_t *pool,
+  vibeParallelJob_t job,
+  void *arg
+);
+
+/**
+ * Stops the threads and frees the pool. The model is not freed.
+ *
+ * @param pool
+ * @return
+ */
+int32_t libvibeParallel_Free(vibeParallel_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
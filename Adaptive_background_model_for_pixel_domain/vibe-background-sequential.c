@@ -48,6 +48,11 @@ Likewise, instead of a random selection of the neighboring model to be updated,
 #include <assert.h>
 #include <time.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VIBE_HAVE_AVX2_KERNELS
+#endif
+
 #include "vibe-background-sequential.h"
 
 #define NUMBER_OF_HISTORY_IMAGES 20
@@ -62,6 +67,12 @@ static inline int32_t distance_is_close_8u_C3R(uint8_t r1, uint8_t g1, uint8_t b
   return (abs_uint(r1 - r2) + abs_uint(g1 - g2) + abs_uint(b1 - b2) <= 4.5 * threshold);
 }
 
+/* Integer form of the C3R test "distance <= 4.5 * threshold", exact since distances are integers. */
+static inline uint32_t l1_threshold_8u_C3R(uint32_t threshold)
+{
+  return (9 * threshold) / 2;
+}
+
 struct vibeModel_Sequential
 {
   /* Parameters. */
@@ -76,6 +87,12 @@ struct vibeModel_Sequential
   uint8_t *historyImage;  //20 Backgrounds
   uint32_t lastHistoryImageSwapped;
 
+  /* Subsampled chroma history of YUV420 models, U then V plane of every sample. */
+  uint8_t *historyChroma;
+
+  /* Quantized history of packed C3R models, one 16-bit word per pixel and per sample. */
+  uint16_t *historyPacked;
+
   /* Buffers with random values. */
   uint32_t *jump;
   int *neighbor;
@@ -121,6 +138,8 @@ vibeModel_Sequential_t *libvibeModel_Sequential_New()
   /* Storage for the history. */
   model->historyImage            = NULL;
   model->lastHistoryImageSwapped = 0;
+  model->historyChroma           = NULL;
+  model->historyPacked           = NULL;
 
   /* Buffers with random values. */
   model->jump                    = NULL;
@@ -153,6 +172,16 @@ uint32_t libvibeModel_Sequential_GetUpdateFactor(const vibeModel_Sequential_t *m
   assert(model != NULL); return(model->updateFactor);
 }
 
+uint32_t libvibeModel_Sequential_GetWidth(const vibeModel_Sequential_t *model)
+{
+  assert(model != NULL); return(model->width);
+}
+
+uint32_t libvibeModel_Sequential_GetHeight(const vibeModel_Sequential_t *model)
+{
+  assert(model != NULL); return(model->height);
+}
+
 // -----------------------------------------------------------------------------
 // Some "Set-ers"
 // -----------------------------------------------------------------------------
@@ -191,6 +220,8 @@ int32_t libvibeModel_Sequential_Free(vibeModel_Sequential_t *model)
 
 
   free(model->historyImage);
+  free(model->historyChroma);
+  free(model->historyPacked);
   free(model->jump);
   free(model->neighbor);
   free(model->position);
@@ -203,6 +234,30 @@ int32_t libvibeModel_Sequential_Free(vibeModel_Sequential_t *model)
 // -------------------------- The same for C3R models -------------------------
 // ----------------------------------------------------------------------------
 
+// -----------------------------------------------------------------------------
+// Allocates and fills the buffers with random values
+// -----------------------------------------------------------------------------
+static void alloc_random_buffers(vibeModel_Sequential_t *model)
+{
+  uint32_t width = model->width;
+  int size = (model->width > model->height) ? 2 * model->width + 1 : 2 * model->height + 1;
+
+  model->jump = (uint32_t*)malloc(size * sizeof(*(model->jump)));
+  assert(model->jump != NULL);
+
+  model->neighbor = (int*)malloc(size * sizeof(*(model->neighbor)));
+  assert(model->neighbor != NULL);
+
+  model->position = (uint32_t*)malloc(size * sizeof(*(model->position)));
+  assert(model->position != NULL);
+
+  for (int i = 0; i < size; ++i) {
+    model->jump[i] = (rand() % (2 * model->updateFactor)) + 1;            // Values between 1 and 2 * updateFactor.
+    model->neighbor[i] = ((rand() % 3) - 1) + ((rand() % 3) - 1) * width; // Values between { width - 1, ... , width + 1 }.
+    model->position[i] = rand() % (model->numberOfSamples);               // Values between 0 and numberOfSamples - 1.
+  }
+}
+
 // -----------------------------------------------------------------------------
 // Allocates and initializes a C3R model structure
 // -----------------------------------------------------------------------------
@@ -233,22 +288,7 @@ int32_t libvibeModel_Sequential_AllocInit_8u_C3R(
   assert(model->historyImage != NULL);
 
   /* Fills the buffers with random values. */
-  int size = (width > height) ? 2 * width + 1 : 2 * height + 1;
-
-  model->jump = (uint32_t*)malloc(size * sizeof(*(model->jump)));
-  assert(model->jump != NULL);
-
-  model->neighbor = (int*)malloc(size * sizeof(*(model->neighbor)));
-  assert(model->neighbor != NULL);
-
-  model->position = (uint32_t*)malloc(size * sizeof(*(model->position)));
-  assert(model->position != NULL);
-
-  for (int i = 0; i < size; ++i) {
-    model->jump[i] = (rand() % (2 * model->updateFactor)) + 1;            // Values between 1 and 2 * updateFactor.
-    model->neighbor[i] = ((rand() % 3) - 1) + ((rand() % 3) - 1) * width; // Values between { width - 1, ... , width + 1 }.
-    model->position[i] = rand() % (model->numberOfSamples);               // Values between 0 and numberOfSamples - 1.
-  }
+  alloc_random_buffers(model);
 
   return(0);
 }
@@ -465,3 +505,887 @@ int32_t libvibeModel_Sequential_Update_8u_C3R(
 
   return(0);
 }
+
+// ----------------------------------------------------------------------------
+// ------------------------- C3R models, tile by tile -------------------------
+// ----------------------------------------------------------------------------
+
+/* Small xorshift generator, so that tiles processed concurrently do not share rand(). */
+static inline uint32_t tile_rand(uint32_t *state)
+{
+  uint32_t x = *state;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+
+  return(x);
+}
+
+// -----------------------------------------------------------------------------
+// Segmentation of a tile of a C3R model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_SegmentationTile_8u_C3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map,
+  const uint32_t x0,
+  const uint32_t y0,
+  const uint32_t x1,
+  const uint32_t y1
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (segmentation_map != NULL));
+  assert((x0 <= x1) && (x1 <= model->width) && (y0 <= y1) && (y1 <= model->height));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t count = width * model->height;
+  uint32_t threshold = l1_threshold_8u_C3R(model->matchingThreshold);
+
+  /* Same decision as libvibeModel_Sequential_Segmentation_8u_C3R, but every pixel
+     stops scanning its samples once it has enough matches. */
+  for (uint32_t y = y0; y < y1; ++y) {
+    for (uint32_t x = x0; x < x1; ++x) {
+      uint32_t index = x + y * width;
+      const uint8_t *pixel = image_data + 3 * index;
+      uint32_t remaining = model->matchingNumber;
+
+      for (int i = 0; (i < NUMBER_OF_HISTORY_IMAGES) && (remaining > 0); ++i) {
+        const uint8_t *pels = model->historyImage + 3 * (i * count + index);
+
+        if (abs_uint(pixel[0] - pels[0]) + abs_uint(pixel[1] - pels[1]) + abs_uint(pixel[2] - pels[2]) <= (int)threshold)
+          --remaining;
+      }
+
+      segmentation_map[index] = (remaining > 0) ? COLOR_FOREGROUND : COLOR_BACKGROUND;
+    }
+  }
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// Update of a tile of a C3R model
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_UpdateTile_8u_C3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *updating_mask,
+  const uint32_t x0,
+  const uint32_t y0,
+  const uint32_t x1,
+  const uint32_t y1,
+  uint32_t *seed
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (updating_mask != NULL) && (seed != NULL) && (*seed != 0));
+  assert((model->jump != NULL) && (model->neighbor != NULL) && (model->position != NULL));
+  assert((x0 <= x1) && (x1 <= model->width) && (y0 <= y1) && (y1 <= model->height));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  uint32_t count = width * height;
+
+  uint8_t *historyImage = model->historyImage;
+  uint32_t *jump = model->jump;
+  int *neighbor = model->neighbor;
+  uint32_t *position = model->position;
+
+  for (uint32_t y = y0; y < y1; ++y) {
+    uint32_t shift = tile_rand(seed) % width;
+    uint32_t x = x0 + jump[shift] - 1;
+
+    while (x < x1) {
+      uint32_t index = x + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND) {
+        uint8_t *pels = historyImage + 3 * (position[shift] * count + index);
+
+        pels[0] = image_data[3 * index];
+        pels[1] = image_data[3 * index + 1];
+        pels[2] = image_data[3 * index + 2];
+
+        /* Pixels on the border of the image do not propagate, as in the full update. The
+           neighbor can be one pixel outside of the tile: the caller keeps that halo free. */
+        if ((x > 0) && (y > 0) && (x < width - 1) && (y < height - 1)) {
+          pels += 3 * neighbor[shift];
+          pels[0] = image_data[3 * index];
+          pels[1] = image_data[3 * index + 1];
+          pels[2] = image_data[3 * index + 2];
+        }
+      }
+
+      ++shift;
+      x += jump[shift];
+    }
+  }
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// ------------------- The same for P3R (planar) models -----------------------
+// ----------------------------------------------------------------------------
+
+/*
+ * The image and every sample of the history are stored as three consecutive
+ * planes of width * height bytes, so that the same channel of neighboring
+ * pixels is contiguous in memory. Sample i, channel c starts at
+ * historyImage + (3 * i + c) * width * height.
+ */
+
+// -----------------------------------------------------------------------------
+// Allocates and initializes a P3R model structure
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_AllocInit_8u_P3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Some basic checks. */
+  assert((image_data != NULL) && (model != NULL));
+  assert((width > 0) && (height > 0));
+
+  /* Finish model alloc - parameters values cannot be changed anymore. */
+  model->width = width;
+  model->height = height;
+
+  /* Creates the historyImage structure. */
+  model->historyImage = (uint8_t*)malloc(NUMBER_OF_HISTORY_IMAGES * (3 * width) * height * sizeof(uint8_t));
+  assert(model->historyImage != NULL);
+
+  for (int i = 0; i < NUMBER_OF_HISTORY_IMAGES; ++i)
+    memcpy(model->historyImage + i * (3 * width) * height, image_data, (3 * width) * height);
+
+  /* Fills the buffers with random values. */
+  alloc_random_buffers(model);
+
+  return(0);
+}
+
+#ifdef VIBE_HAVE_AVX2_KERNELS
+/*
+ * Counts down the matches of 32 pixels at once. The L1 color distance is built
+ * with saturating byte arithmetic, which is exact as long as the threshold is
+ * below 255. Returns the number of pixels processed, a multiple of 32.
+ */
+__attribute__((target("avx2")))
+static uint32_t segmentation_8u_P3R_avx2(
+  const uint8_t *image_data,
+  const uint8_t *historyImage,
+  uint8_t *segmentation_map,
+  const uint32_t count,
+  const uint8_t matchingNumber,
+  const uint8_t threshold
+) {
+  const __m256i vthreshold = _mm256_set1_epi8((char)threshold);
+  const __m256i vone = _mm256_set1_epi8(1);
+  const __m256i vzero = _mm256_setzero_si256();
+  const __m256i vforeground = _mm256_set1_epi8((char)COLOR_FOREGROUND);
+  uint32_t index;
+
+  for (index = 0; index + 32 <= count; index += 32) {
+    __m256i c0 = _mm256_loadu_si256((const __m256i*)(image_data + index));
+    __m256i c1 = _mm256_loadu_si256((const __m256i*)(image_data + count + index));
+    __m256i c2 = _mm256_loadu_si256((const __m256i*)(image_data + 2 * count + index));
+    __m256i remaining = _mm256_set1_epi8((char)matchingNumber);
+
+    for (int i = 0; i < NUMBER_OF_HISTORY_IMAGES; ++i) {
+      const uint8_t *pels = historyImage + 3 * i * count + index;
+      __m256i p0 = _mm256_loadu_si256((const __m256i*)pels);
+      __m256i p1 = _mm256_loadu_si256((const __m256i*)(pels + count));
+      __m256i p2 = _mm256_loadu_si256((const __m256i*)(pels + 2 * count));
+
+      __m256i d0 = _mm256_or_si256(_mm256_subs_epu8(c0, p0), _mm256_subs_epu8(p0, c0));
+      __m256i d1 = _mm256_or_si256(_mm256_subs_epu8(c1, p1), _mm256_subs_epu8(p1, c1));
+      __m256i d2 = _mm256_or_si256(_mm256_subs_epu8(c2, p2), _mm256_subs_epu8(p2, c2));
+      __m256i distance = _mm256_adds_epu8(_mm256_adds_epu8(d0, d1), d2);
+      __m256i close = _mm256_cmpeq_epi8(_mm256_min_epu8(distance, vthreshold), distance);
+
+      remaining = _mm256_subs_epu8(remaining, _mm256_and_si256(close, vone));
+
+      /* Stops as soon as all 32 pixels have found enough matches. */
+      if (_mm256_testc_si256(vzero, remaining))
+        break;
+    }
+
+    __m256i background = _mm256_cmpeq_epi8(remaining, vzero);
+    _mm256_storeu_si256((__m256i*)(segmentation_map + index), _mm256_andnot_si256(background, vforeground));
+  }
+
+  return(index);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Segmentation of a P3R model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Segmentation_8u_P3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (segmentation_map != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->jump != NULL) && (model->neighbor != NULL) && (model->position != NULL));
+
+  /* Some variables. */
+  uint32_t count = model->width * model->height;
+  uint32_t matchingNumber = model->matchingNumber;
+  uint32_t threshold = l1_threshold_8u_C3R(model->matchingThreshold);
+
+  uint8_t *historyImage = model->historyImage;
+  uint32_t index = 0;
+
+#ifdef VIBE_HAVE_AVX2_KERNELS
+  if ((threshold < 255) && (matchingNumber < 256) && __builtin_cpu_supports("avx2"))
+    index = segmentation_8u_P3R_avx2(image_data, historyImage, segmentation_map, count, matchingNumber, threshold);
+#endif
+
+  /* Remaining pixels, or all of them without AVX2. */
+  for (; index < count; ++index) {
+    uint32_t remaining = matchingNumber;
+
+    for (int i = 0; (i < NUMBER_OF_HISTORY_IMAGES) && (remaining > 0); ++i) {
+      const uint8_t *pels = historyImage + 3 * i * count + index;
+
+      if (
+        abs_uint(image_data[index] - pels[0]) +
+        abs_uint(image_data[count + index] - pels[count]) +
+        abs_uint(image_data[2 * count + index] - pels[2 * count]) <= (int)threshold
+      )
+        --remaining;
+    }
+
+    segmentation_map[index] = (remaining > 0) ? COLOR_FOREGROUND : COLOR_BACKGROUND;
+  }
+
+  return(0);
+}
+
+/* Copies the three planes of pixel image_index into sample position at pixel index. */
+static inline void replace_sample_8u_P3R(
+  uint8_t *historyImage,
+  const uint8_t *image_data,
+  const uint32_t count,
+  const uint32_t position,
+  const int index,
+  const int image_index
+) {
+  uint8_t *pels = historyImage + 3 * position * count + index;
+
+  pels[0] = image_data[image_index];
+  pels[count] = image_data[count + image_index];
+  pels[2 * count] = image_data[2 * count + image_index];
+}
+
+// ----------------------------------------------------------------------------
+// Update a P3R model
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Update_8u_P3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *updating_mask
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (updating_mask != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->jump != NULL) && (model->neighbor != NULL) && (model->position != NULL));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  uint32_t count = width * height;
+
+  uint8_t *historyImage = model->historyImage;
+
+  /* Updating. Same random walks as libvibeModel_Sequential_Update_8u_C3R. */
+  uint32_t *jump = model->jump;
+  int *neighbor = model->neighbor;
+  uint32_t *position = model->position;
+
+  /* All the frame, except the border. */
+  uint32_t shift, indX, indY;
+  int x, y;
+
+  for (y = 1; y < height - 1; ++y) {
+    shift = rand() % width;
+    indX = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indX < width - 1) {
+      int index = indX + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND) {
+        /* In-place substitution. */
+        replace_sample_8u_P3R(historyImage, image_data, count, position[shift], index, index);
+        replace_sample_8u_P3R(historyImage, image_data, count, position[shift], index + neighbor[shift], index);
+      }
+
+      ++shift;
+      indX += jump[shift];
+    }
+  }
+
+  /* First and last rows. */
+  for (y = 0; y < height; y += height - 1) {
+    shift = rand() % width;
+    indX = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indX <= width - 1) {
+      int index = indX + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND)
+        replace_sample_8u_P3R(historyImage, image_data, count, position[shift], index, index);
+
+      ++shift;
+      indX += jump[shift];
+    }
+
+    if (height == 1)
+      break;
+  }
+
+  /* First and last columns. */
+  for (x = 0; x < width; x += width - 1) {
+    shift = rand() % height;
+    indY = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indY <= height - 1) {
+      int index = x + indY * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND)
+        replace_sample_8u_P3R(historyImage, image_data, count, position[shift], index, index);
+
+      ++shift;
+      indY += jump[shift];
+    }
+
+    if (width == 1)
+      break;
+  }
+
+  /* The first pixel! */
+  if (rand() % model->updateFactor == 0) {
+    if (updating_mask[0] == 0) {
+      int position = rand() % model->numberOfSamples;
+
+      if (position < NUMBER_OF_HISTORY_IMAGES)
+        replace_sample_8u_P3R(historyImage, image_data, count, position, 0, 0);
+    }
+  }
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// ---------------------- The same for YUV420 models --------------------------
+// ----------------------------------------------------------------------------
+
+/*
+ * Luma samples are stored like C1R samples, one plane of width * height bytes
+ * per sample. Chroma samples keep the 2x2 subsampling of the input: sample i
+ * has its U plane at historyChroma + 2 * i * chromaSize and its V plane right
+ * after, chromaSize being ((width + 1) / 2) * ((height + 1) / 2).
+ */
+
+static inline uint32_t chroma_width(const vibeModel_Sequential_t *model)
+{
+  return (model->width + 1) / 2;
+}
+
+static inline uint32_t chroma_size(const vibeModel_Sequential_t *model)
+{
+  return chroma_width(model) * ((model->height + 1) / 2);
+}
+
+// -----------------------------------------------------------------------------
+// Allocates and initializes a YUV420 model structure
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_AllocInit_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Some basic checks. */
+  assert((image != NULL) && (model != NULL));
+  assert((image->y != NULL) && (image->u != NULL) && (image->v != NULL));
+  assert((width > 0) && (height > 0));
+  assert((image->yStride >= width) && (image->uvStride >= (width + 1) / 2));
+
+  /* Finish model alloc - parameters values cannot be changed anymore. */
+  model->width = width;
+  model->height = height;
+
+  uint32_t chromaWidth = chroma_width(model);
+  uint32_t chromaHeight = (height + 1) / 2;
+  uint32_t chromaSize = chroma_size(model);
+
+  /* Creates the historyImage structures, 1.5 bytes per pixel and per sample. */
+  model->historyImage = (uint8_t*)malloc(NUMBER_OF_HISTORY_IMAGES * width * height * sizeof(uint8_t));
+  assert(model->historyImage != NULL);
+
+  model->historyChroma = (uint8_t*)malloc(NUMBER_OF_HISTORY_IMAGES * 2 * chromaSize * sizeof(uint8_t));
+  assert(model->historyChroma != NULL);
+
+  for (int i = 0; i < NUMBER_OF_HISTORY_IMAGES; ++i) {
+    for (uint32_t y = 0; y < height; ++y)
+      memcpy(model->historyImage + i * width * height + y * width, image->y + y * image->yStride, width);
+
+    for (uint32_t y = 0; y < chromaHeight; ++y) {
+      memcpy(model->historyChroma + 2 * i * chromaSize + y * chromaWidth, image->u + y * image->uvStride, chromaWidth);
+      memcpy(model->historyChroma + (2 * i + 1) * chromaSize + y * chromaWidth, image->v + y * image->uvStride, chromaWidth);
+    }
+  }
+
+  /* Fills the buffers with random values. */
+  alloc_random_buffers(model);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Segmentation of a YUV420 model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Segmentation_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  uint8_t *segmentation_map
+) {
+  /* Basic checks. */
+  assert((image != NULL) && (model != NULL) && (segmentation_map != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->historyImage != NULL) && (model->historyChroma != NULL));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  uint32_t chromaWidth = chroma_width(model);
+  uint32_t chromaSize = chroma_size(model);
+  uint32_t threshold = l1_threshold_8u_C3R(model->matchingThreshold);
+
+  /* Segmentation. Pixels stop scanning the samples as soon as they have enough
+     matches, which happens within the first samples for most of the background. */
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *luma = image->y + y * image->yStride;
+    const uint8_t *u = image->u + (y / 2) * image->uvStride;
+    const uint8_t *v = image->v + (y / 2) * image->uvStride;
+
+    for (uint32_t x = 0; x < width; ++x) {
+      uint32_t index = x + y * width;
+      uint32_t chromaIndex = (x / 2) + (y / 2) * chromaWidth;
+      uint32_t remaining = model->matchingNumber;
+
+      for (int i = 0; (i < NUMBER_OF_HISTORY_IMAGES) && (remaining > 0); ++i) {
+        const uint8_t *pelsU = model->historyChroma + 2 * i * chromaSize;
+
+        if (
+          abs_uint(luma[x] - model->historyImage[i * width * height + index]) +
+          abs_uint(u[x / 2] - pelsU[chromaIndex]) +
+          abs_uint(v[x / 2] - pelsU[chromaSize + chromaIndex]) <= (int)threshold
+        )
+          --remaining;
+      }
+
+      segmentation_map[index] = (remaining > 0) ? COLOR_FOREGROUND : COLOR_BACKGROUND;
+    }
+  }
+
+  return(0);
+}
+
+/* Copies the luma of pixel (x, y) and the chroma of its 2x2 block into sample position at (nx, ny). */
+static inline void replace_sample_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  const uint32_t position,
+  const uint32_t x,
+  const uint32_t y,
+  const uint32_t nx,
+  const uint32_t ny
+) {
+  uint32_t chromaSize = chroma_size(model);
+  uint32_t chromaIndex = (nx / 2) + (ny / 2) * chroma_width(model);
+  uint8_t *pelsU = model->historyChroma + 2 * position * chromaSize;
+
+  model->historyImage[position * model->width * model->height + nx + ny * model->width] = image->y[x + y * image->yStride];
+  pelsU[chromaIndex] = image->u[(x / 2) + (y / 2) * image->uvStride];
+  pelsU[chromaSize + chromaIndex] = image->v[(x / 2) + (y / 2) * image->uvStride];
+}
+
+// ----------------------------------------------------------------------------
+// Update a YUV420 model
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Update_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  uint8_t *updating_mask
+) {
+  /* Basic checks. */
+  assert((image != NULL) && (model != NULL) && (updating_mask != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->jump != NULL) && (model->neighbor != NULL) && (model->position != NULL));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+
+  /* Updating. Same random walks as libvibeModel_Sequential_Update_8u_C3R. */
+  uint32_t *jump = model->jump;
+  int *neighbor = model->neighbor;
+  uint32_t *position = model->position;
+
+  /* All the frame, except the border. */
+  uint32_t shift, indX, indY;
+  int x, y;
+
+  for (y = 1; y < height - 1; ++y) {
+    shift = rand() % width;
+    indX = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indX < width - 1) {
+      int index = indX + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND) {
+        /* In-place substitution. The offset is dx + dy * width with dx and dy in { -1, 0, 1 }. */
+        int offset = neighbor[shift] + width + 1;
+        int nx = indX + (offset % (int)width) - 1;
+        int ny = y + (offset / (int)width) - 1;
+
+        replace_sample_8u_YUV420(model, image, position[shift], indX, y, indX, y);
+        replace_sample_8u_YUV420(model, image, position[shift], indX, y, nx, ny);
+      }
+
+      ++shift;
+      indX += jump[shift];
+    }
+  }
+
+  /* First and last rows. */
+  for (y = 0; y < height; y += height - 1) {
+    shift = rand() % width;
+    indX = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indX <= width - 1) {
+      if (updating_mask[indX + y * width] == COLOR_BACKGROUND)
+        replace_sample_8u_YUV420(model, image, position[shift], indX, y, indX, y);
+
+      ++shift;
+      indX += jump[shift];
+    }
+
+    if (height == 1)
+      break;
+  }
+
+  /* First and last columns. */
+  for (x = 0; x < width; x += width - 1) {
+    shift = rand() % height;
+    indY = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indY <= height - 1) {
+      if (updating_mask[x + indY * width] == COLOR_BACKGROUND)
+        replace_sample_8u_YUV420(model, image, position[shift], x, indY, x, indY);
+
+      ++shift;
+      indY += jump[shift];
+    }
+
+    if (width == 1)
+      break;
+  }
+
+  /* The first pixel! */
+  if (rand() % model->updateFactor == 0) {
+    if (updating_mask[0] == 0) {
+      int position = rand() % model->numberOfSamples;
+
+      if (position < NUMBER_OF_HISTORY_IMAGES)
+        replace_sample_8u_YUV420(model, image, position, 0, 0, 0, 0);
+    }
+  }
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// ------------------- The same for packed C3R models -------------------------
+// ----------------------------------------------------------------------------
+
+/*
+ * Every sample keeps the PACKED_BITS_PER_CHANNEL most significant bits of each
+ * channel, packed as c0 | c1 << bits | c2 << (2 * bits) in a 16-bit word. A
+ * quantized channel q stands for the middle of its interval, (q << shift) + half,
+ * so that the error of a sample is at most half in absolute value, with half
+ * being 1 << (shift - 1) and shift = 8 - bits. Fewer bits would not fit more
+ * samples in the word, only lose accuracy.
+ */
+#define PACKED_BITS_PER_CHANNEL 5
+
+static inline uint16_t pack_8u_C3R(const uint8_t *pixel, const uint32_t bits)
+{
+  uint32_t shift = 8 - bits;
+
+  return (uint16_t)((pixel[0] >> shift) | ((pixel[1] >> shift) << bits) | ((pixel[2] >> shift) << (2 * bits)));
+}
+
+static inline int unpack_channel(const uint16_t word, const uint32_t channel, const uint32_t bits)
+{
+  uint32_t shift = 8 - bits;
+
+  return (int)((((word >> (channel * bits)) & ((1 << bits) - 1)) << shift) + (1 << (shift - 1)));
+}
+
+// -----------------------------------------------------------------------------
+// Allocates and initializes a packed C3R model structure
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_AllocInit_8u_C3R_Packed(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Some basic checks. */
+  assert((image_data != NULL) && (model != NULL));
+  assert((width > 0) && (height > 0));
+
+  /* Finish model alloc - parameters values cannot be changed anymore. */
+  model->width = width;
+  model->height = height;
+
+  /* Creates the history, every sample starts as the first frame. */
+  uint32_t count = width * height;
+
+  model->historyPacked = (uint16_t*)malloc(NUMBER_OF_HISTORY_IMAGES * count * sizeof(uint16_t));
+  assert(model->historyPacked != NULL);
+
+  for (uint32_t index = 0; index < count; ++index)
+    model->historyPacked[index] = pack_8u_C3R(image_data + 3 * index, PACKED_BITS_PER_CHANNEL);
+
+  for (int i = 1; i < NUMBER_OF_HISTORY_IMAGES; ++i)
+    memcpy(model->historyPacked + i * count, model->historyPacked, count * sizeof(uint16_t));
+
+  /* Fills the buffers with random values. */
+  alloc_random_buffers(model);
+
+  return(0);
+}
+
+#ifdef __SSE2__
+/*
+ * Matches 8 pixels at once in 16-bit lanes: the channels of the samples are
+ * unpacked with shifts and masks, and |a - b| is computed as the sum of both
+ * saturated differences. Returns the number of pixels processed.
+ */
+static uint32_t segmentation_8u_C3R_packed_sse2(
+  const uint8_t *image_data,
+  const uint16_t *historyPacked,
+  uint8_t *segmentation_map,
+  const uint32_t count,
+  const uint32_t matchingNumber,
+  const uint32_t threshold,
+  const uint32_t bits
+) {
+  const __m128i mask = _mm_set1_epi16((short)((1 << bits) - 1));
+  const __m128i half = _mm_set1_epi16((short)(1 << (7 - bits)));
+  const __m128i vthreshold = _mm_set1_epi16((short)threshold);
+  const __m128i vmatching = _mm_set1_epi16((short)matchingNumber);
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i shift = _mm_cvtsi32_si128(8 - bits);
+  const __m128i shiftG = _mm_cvtsi32_si128(bits);
+  const __m128i shiftB = _mm_cvtsi32_si128(2 * bits);
+  uint32_t index = 0;
+
+  for (; index + 8 <= count; index += 8) {
+    uint16_t channels[3][8];
+
+    for (uint32_t k = 0; k < 8; ++k) {
+      channels[0][k] = image_data[3 * (index + k)];
+      channels[1][k] = image_data[3 * (index + k) + 1];
+      channels[2][k] = image_data[3 * (index + k) + 2];
+    }
+
+    __m128i c0 = _mm_loadu_si128((const __m128i*)channels[0]);
+    __m128i c1 = _mm_loadu_si128((const __m128i*)channels[1]);
+    __m128i c2 = _mm_loadu_si128((const __m128i*)channels[2]);
+    __m128i matches = _mm_setzero_si128();
+
+    for (int i = 0; i < NUMBER_OF_HISTORY_IMAGES; ++i) {
+      __m128i word = _mm_loadu_si128((const __m128i*)(historyPacked + i * count + index));
+      __m128i s0 = _mm_add_epi16(_mm_sll_epi16(_mm_and_si128(word, mask), shift), half);
+      __m128i s1 = _mm_add_epi16(_mm_sll_epi16(_mm_and_si128(_mm_srl_epi16(word, shiftG), mask), shift), half);
+      __m128i s2 = _mm_add_epi16(_mm_sll_epi16(_mm_and_si128(_mm_srl_epi16(word, shiftB), mask), shift), half);
+
+      __m128i distance = _mm_or_si128(_mm_subs_epu16(c0, s0), _mm_subs_epu16(s0, c0));
+      distance = _mm_add_epi16(distance, _mm_or_si128(_mm_subs_epu16(c1, s1), _mm_subs_epu16(s1, c1)));
+      distance = _mm_add_epi16(distance, _mm_or_si128(_mm_subs_epu16(c2, s2), _mm_subs_epu16(s2, c2)));
+
+      matches = _mm_add_epi16(matches, _mm_andnot_si128(_mm_cmpgt_epi16(distance, vthreshold), one));
+
+      /* Stops as soon as the 8 pixels are background. */
+      if (_mm_movemask_epi8(_mm_cmplt_epi16(matches, vmatching)) == 0)
+        break;
+    }
+
+    __m128i foreground = _mm_cmplt_epi16(matches, vmatching);
+    _mm_storel_epi64((__m128i*)(segmentation_map + index), _mm_packs_epi16(foreground, foreground));
+  }
+
+  return(index);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Segmentation of a packed C3R model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Segmentation_8u_C3R_Packed(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (segmentation_map != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert(model->historyPacked != NULL);
+
+  /* Some variables. */
+  uint32_t count = model->width * model->height;
+  uint32_t bits = PACKED_BITS_PER_CHANNEL;
+  uint32_t matchingNumber = model->matchingNumber;
+  uint32_t threshold = l1_threshold_8u_C3R(model->matchingThreshold);
+  uint16_t *historyPacked = model->historyPacked;
+  uint32_t index = 0;
+
+#ifdef __SSE2__
+  if (threshold < 32768)
+    index = segmentation_8u_C3R_packed_sse2(image_data, historyPacked, segmentation_map, count, matchingNumber, threshold, bits);
+#endif
+
+  /* Remaining pixels. */
+  for (; index < count; ++index) {
+    const uint8_t *pixel = image_data + 3 * index;
+    uint32_t remaining = matchingNumber;
+
+    for (int i = 0; (i < NUMBER_OF_HISTORY_IMAGES) && (remaining > 0); ++i) {
+      uint16_t word = historyPacked[i * count + index];
+
+      if (
+        abs_uint(pixel[0] - unpack_channel(word, 0, bits)) +
+        abs_uint(pixel[1] - unpack_channel(word, 1, bits)) +
+        abs_uint(pixel[2] - unpack_channel(word, 2, bits)) <= (int)threshold
+      )
+        --remaining;
+    }
+
+    segmentation_map[index] = (remaining > 0) ? COLOR_FOREGROUND : COLOR_BACKGROUND;
+  }
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// Update a packed C3R model
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Update_8u_C3R_Packed(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *updating_mask
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (updating_mask != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->jump != NULL) && (model->neighbor != NULL) && (model->position != NULL));
+  assert(model->historyPacked != NULL);
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  uint32_t count = width * height;
+  uint32_t bits = PACKED_BITS_PER_CHANNEL;
+
+  uint16_t *historyPacked = model->historyPacked;
+
+  /* Updating. Same random walks as libvibeModel_Sequential_Update_8u_C3R. */
+  uint32_t *jump = model->jump;
+  int *neighbor = model->neighbor;
+  uint32_t *position = model->position;
+
+  /* All the frame, except the border. */
+  uint32_t shift, indX, indY;
+  int x, y;
+
+  for (y = 1; y < height - 1; ++y) {
+    shift = rand() % width;
+    indX = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indX < width - 1) {
+      int index = indX + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND) {
+        /* In-place substitution. */
+        uint16_t word = pack_8u_C3R(image_data + 3 * index, bits);
+
+        historyPacked[position[shift] * count + index] = word;
+        historyPacked[position[shift] * count + index + neighbor[shift]] = word;
+      }
+
+      ++shift;
+      indX += jump[shift];
+    }
+  }
+
+  /* First and last rows. */
+  for (y = 0; y < height; y += height - 1) {
+    shift = rand() % width;
+    indX = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indX <= width - 1) {
+      int index = indX + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND)
+        historyPacked[position[shift] * count + index] = pack_8u_C3R(image_data + 3 * index, bits);
+
+      ++shift;
+      indX += jump[shift];
+    }
+
+    if (height == 1)
+      break;
+  }
+
+  /* First and last columns. */
+  for (x = 0; x < width; x += width - 1) {
+    shift = rand() % height;
+    indY = jump[shift]; // index_jump should never be zero (> 1).
+
+    while (indY <= height - 1) {
+      int index = x + indY * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND)
+        historyPacked[position[shift] * count + index] = pack_8u_C3R(image_data + 3 * index, bits);
+
+      ++shift;
+      indY += jump[shift];
+    }
+
+    if (width == 1)
+      break;
+  }
+
+  /* The first pixel! */
+  if (rand() % model->updateFactor == 0) {
+    if (updating_mask[0] == 0) {
+      int position = rand() % model->numberOfSamples;
+
+      if (position < NUMBER_OF_HISTORY_IMAGES)
+        historyPacked[position * count] = pack_8u_C3R(image_data, bits);
+    }
+  }
+
+  return(0);
+}
@@ -24,6 +24,20 @@ extern "C"
  */
 typedef struct vibeModel_Sequential vibeModel_Sequential_t;
 
+/**
+ * \brief A YUV420 image as handed out by decoders: a full resolution luma
+ * plane and two chroma planes subsampled by 2 in both directions, each with
+ * its own stride (in bytes).
+ */
+typedef struct
+{
+  const uint8_t *y;
+  const uint8_t *u;
+  const uint8_t *v;
+  uint32_t yStride;
+  uint32_t uvStride;
+} vibeImage_YUV420_t;
+
 /**
  * Allocation of a new data structure where the background model will be stored.
  * Please note that this function only creates the structure to host the data.
@@ -125,6 +139,22 @@ uint32_t libvibeModel_Sequential_GetMatchingNumber(const vibeModel_Sequential_t
  */
 uint32_t libvibeModel_Sequential_GetUpdateFactor(const vibeModel_Sequential_t *model);
 
+/**
+ * Getter.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @return The width of the images the model was initialized with.
+ */
+uint32_t libvibeModel_Sequential_GetWidth(const vibeModel_Sequential_t *model);
+
+/**
+ * Getter.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @return The height of the images the model was initialized with.
+ */
+uint32_t libvibeModel_Sequential_GetHeight(const vibeModel_Sequential_t *model);
+
 /**
  * \brief Frees all the memory used by the <tt>model</tt> and deallocates the structure.
  *
@@ -191,8 +221,205 @@ int32_t libvibeModel_Sequential_Update_8u_C3R(
   uint8_t *updating_mask
 );
 
+/**
+ * Segmentation of the tile [x0, x1) x [y0, y1) of a C3R model. The pixels of
+ * the tile get the same labels as with \ref libvibeModel_Sequential_Segmentation_8u_C3R,
+ * and tiles can be processed concurrently since they only read the model.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param segmentation_map
+ * @param x0 First column of the tile.
+ * @param y0 First row of the tile.
+ * @param x1 Column after the last one of the tile.
+ * @param y1 Row after the last one of the tile.
+ * @return
+ */
+int32_t libvibeModel_Sequential_SegmentationTile_8u_C3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map,
+  const uint32_t x0,
+  const uint32_t y0,
+  const uint32_t x1,
+  const uint32_t y1
+);
+
+/**
+ * Update of the tile [x0, x1) x [y0, y1) of a C3R model. Random numbers are
+ * drawn from *seed instead of rand(), so every thread must use its own seed.
+ * A background pixel can also update a neighbor one pixel outside of the tile:
+ * tiles updated concurrently must not touch each other's halo.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param updating_mask
+ * @param x0 First column of the tile.
+ * @param y0 First row of the tile.
+ * @param x1 Column after the last one of the tile.
+ * @param y1 Row after the last one of the tile.
+ * @param seed State of the random generator of the caller, must not be 0.
+ * @return
+ */
+int32_t libvibeModel_Sequential_UpdateTile_8u_C3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *updating_mask,
+  const uint32_t x0,
+  const uint32_t y0,
+  const uint32_t x1,
+  const uint32_t y1,
+  uint32_t *seed
+);
+
+// -------------------------  Three channel planar images ----------------------
+/**
+ * The pixel values of color images are arranged in three consecutive planes
+ * RRR...GGG...BBB... of width * height bytes each, and the history of the
+ * model uses the same layout. The segmentation matches 32 pixels at once on
+ * processors with AVX2. Decisions are the same as with the C3R functions.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibeModel_Sequential_AllocInit_8u_P3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ * The pixel values of color images are arranged in three consecutive planes
+ * RRR...GGG...BBB...
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibeModel_Sequential_Segmentation_8u_P3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+);
+
+/**
+ * The pixel values of color images are arranged in three consecutive planes
+ * RRR...GGG...BBB...
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param updating_mask
+ * @return
+ */
+int32_t libvibeModel_Sequential_Update_8u_P3R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *updating_mask
+);
+
+// -------------------------  YUV420 images -----------------------------------
+/**
+ * The luma plane is matched at full resolution and the chroma planes at their
+ * subsampled resolution, so the model stores 1.5 bytes per pixel and per
+ * sample instead of 3. The distance between a pixel and a sample is
+ * |Y - Ys| + |U - Us| + |V - Vs|, with the same threshold as the C3R model.
+ * The planes are read in place, no color conversion is needed.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibeModel_Sequential_AllocInit_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibeModel_Sequential_Segmentation_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  uint8_t *segmentation_map
+);
+
+/**
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image
+ * @param updating_mask
+ * @return
+ */
+int32_t libvibeModel_Sequential_Update_8u_YUV420(
+  vibeModel_Sequential_t *model,
+  const vibeImage_YUV420_t *image,
+  uint8_t *updating_mask
+);
+
+// -------------------------  Packed three channel images ---------------------
+/**
+ * Same images as the C3R functions, but every sample of the history only keeps
+ * the 5 most significant bits of each channel, packed in a 16-bit word. With 20
+ * samples, a 1920x1080 model then takes 83 MB instead of 124 MB. The
+ * quantization moves a sample by at most 4 per channel, which is small compared
+ * to the default matching threshold.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibeModel_Sequential_AllocInit_8u_C3R_Packed(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ * Matches the pixels directly against the packed samples, 8 pixels at once
+ * with SSE2.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibeModel_Sequential_Segmentation_8u_C3R_Packed(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+);
+
+/**
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param updating_mask
+ * @return
+ */
+int32_t libvibeModel_Sequential_Update_8u_C3R_Packed(
+  vibeModel_Sequential_t *model,
+  const uint8_t *image_data,
+  uint8_t *updating_mask
+);
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif  
+#endif
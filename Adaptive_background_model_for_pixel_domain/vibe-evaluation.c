@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "vibe-evaluation.h"
+
+// -----------------------------------------------------------------------------
+// Counts of a frame: the classes of every pixel are masks, added to byte
+// counters that are flushed before they wrap
+// -----------------------------------------------------------------------------
+int32_t libvibeEvaluation_Count_8u_C1R(
+  vibeConfusion_t *confusion,
+  const uint8_t *ground_truth,
+  const uint8_t *segmentation_map,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Basic checks. */
+  assert((confusion != NULL) && (ground_truth != NULL) && (segmentation_map != NULL));
+
+  size_t size = (size_t)width * height;
+  size_t i = 0;
+  uint64_t truePositives = 0, falsePositives = 0, falseNegatives = 0, unknown = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i unknownValue = _mm_set1_epi8((char)VIBE_GROUND_TRUTH_UNKNOWN);
+
+  while (i + 16 <= size) {
+    __m128i tp = zero, fp = zero, fn = zero, un = zero;
+    size_t end = i + 16 * 255;
+    if (end > size)
+      end = size;
+
+    for (; i + 16 <= end; i += 16) {
+      __m128i gt = _mm_loadu_si128((const __m128i*)(ground_truth + i));
+      __m128i map = _mm_loadu_si128((const __m128i*)(segmentation_map + i));
+
+      __m128i gtUnknown = _mm_cmpeq_epi8(gt, unknownValue);
+      __m128i gtBackground = _mm_cmpeq_epi8(gt, zero);
+      __m128i gtForeground = _mm_andnot_si128(_mm_or_si128(gtUnknown, gtBackground), _mm_set1_epi8(-1));
+      __m128i mapBackground = _mm_or_si128(_mm_cmpeq_epi8(map, zero), _mm_cmpeq_epi8(map, unknownValue));
+
+      /* A mask is -1 per byte: subtracting it counts. */
+      tp = _mm_sub_epi8(tp, _mm_andnot_si128(mapBackground, gtForeground));
+      fn = _mm_sub_epi8(fn, _mm_and_si128(mapBackground, gtForeground));
+      fp = _mm_sub_epi8(fp, _mm_andnot_si128(mapBackground, gtBackground));
+      un = _mm_sub_epi8(un, gtUnknown);
+    }
+
+    /* Sums of the 16 byte counters. */
+    __m128i sums;
+    sums = _mm_sad_epu8(tp, zero);
+    truePositives += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    sums = _mm_sad_epu8(fp, zero);
+    falsePositives += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    sums = _mm_sad_epu8(fn, zero);
+    falseNegatives += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+    sums = _mm_sad_epu8(un, zero);
+    unknown += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+  }
+#endif
+
+  for (; i < size; ++i) {
+    uint8_t gt = ground_truth[i];
+    int mapForeground = (segmentation_map[i] != 0) && (segmentation_map[i] != VIBE_GROUND_TRUTH_UNKNOWN);
+
+    if (gt == VIBE_GROUND_TRUTH_UNKNOWN)
+      ++unknown;
+    else if (gt != 0) {
+      truePositives += mapForeground;
+      falseNegatives += !mapForeground;
+    }
+    else
+      falsePositives += mapForeground;
+  }
+
+  confusion->truePositives = truePositives;
+  confusion->falsePositives = falsePositives;
+  confusion->falseNegatives = falseNegatives;
+  confusion->unknown = unknown;
+  confusion->trueNegatives = size - truePositives - falsePositives - falseNegatives - unknown;
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Cumulative counts
+// -----------------------------------------------------------------------------
+int32_t libvibeEvaluation_Add(vibeConfusion_t *total, const vibeConfusion_t *frame)
+{
+  assert((total != NULL) && (frame != NULL));
+
+  total->truePositives += frame->truePositives;
+  total->falsePositives += frame->falsePositives;
+  total->trueNegatives += frame->trueNegatives;
+  total->falseNegatives += frame->falseNegatives;
+  total->unknown += frame->unknown;
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Scores
+// -----------------------------------------------------------------------------
+double libvibeEvaluation_Recall(const vibeConfusion_t *confusion)
+{
+  assert(confusion != NULL);
+
+  uint64_t positives = confusion->truePositives + confusion->falseNegatives;
+  return((positives == 0) ? 1 : (double)confusion->truePositives / positives);
+}
+
+double libvibeEvaluation_Precision(const vibeConfusion_t *confusion)
+{
+  assert(confusion != NULL);
+
+  uint64_t detections = confusion->truePositives + confusion->falsePositives;
+  return((detections == 0) ? 1 : (double)confusion->truePositives / detections);
+}
@@ -0,0 +1,73 @@
+#ifndef _VIBE_EVALUATION_H_
+#define _VIBE_EVALUATION_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * \typedef struct vibeConfusion_t
+ * \brief Counts of pixels of a segmentation map against its ground truth.
+ *
+ * Ground truth pixels of value 85 are unknown and only counted as such, other
+ * non-zero pixels are foreground. Segmentation pixels of value 0 or 85 are
+ * background, all others foreground.
+ */
+typedef struct
+{
+  uint64_t truePositives;
+  uint64_t falsePositives;
+  uint64_t trueNegatives;
+  uint64_t falseNegatives;
+  uint64_t unknown;
+} vibeConfusion_t;
+
+#define VIBE_GROUND_TRUTH_UNKNOWN 85
+
+/**
+ * Counts the pixels of a frame in a single pass, 16 at once with SSE2.
+ *
+ * @param confusion Counts of the frame, overwritten.
+ * @param ground_truth One byte per pixel.
+ * @param segmentation_map One byte per pixel.
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibeEvaluation_Count_8u_C1R(
+  vibeConfusion_t *confusion,
+  const uint8_t *ground_truth,
+  const uint8_t *segmentation_map,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ * Adds the counts of a frame to cumulative counts.
+ *
+ * @param total
+ * @param frame
+ * @return
+ */
+int32_t libvibeEvaluation_Add(vibeConfusion_t *total, const vibeConfusion_t *frame);
+
+/**
+ * @param confusion
+ * @return TP / (TP + FN), 1 without foreground in the ground truth.
+ */
+double libvibeEvaluation_Recall(const vibeConfusion_t *confusion);
+
+/**
+ * @param confusion
+ * @return TP / (TP + FP), 1 without foreground in the segmentation map.
+ */
+double libvibeEvaluation_Precision(const vibeConfusion_t *confusion);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
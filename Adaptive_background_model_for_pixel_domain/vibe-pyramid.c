@@ -0,0 +1,257 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vibe-pyramid.h"
+
+#define PYRAMID_SCALE 4
+
+struct vibePyramid
+{
+  /* Parameters. */
+  uint32_t width;
+  uint32_t height;
+  uint32_t tileSize;
+
+  /* Models at full resolution and at 1/PYRAMID_SCALE in both directions. */
+  vibeModel_Sequential_t *fine;
+  vibeModel_Sequential_t *coarse;
+
+  /* Coarse frame and its segmentation map. */
+  uint32_t coarseWidth;
+  uint32_t coarseHeight;
+  uint8_t *coarseImage;
+  uint8_t *coarseMap;
+
+  /* One byte per tile: foreground seen in the tile, then dilated. */
+  uint32_t tilesPerRow;
+  uint32_t tilesPerColumn;
+  uint8_t *activity;
+  uint8_t *dilated;
+  uint32_t activeTiles;
+};
+
+// -----------------------------------------------------------------------------
+// Box filter of PYRAMID_SCALE x PYRAMID_SCALE pixels, the rest of the frame is dropped
+// -----------------------------------------------------------------------------
+static void downscale_8u_C3R(vibePyramid_t *pyramid, const uint8_t *image_data)
+{
+  uint32_t width = pyramid->width;
+
+  for (uint32_t cy = 0; cy < pyramid->coarseHeight; ++cy) {
+    const uint8_t *rows = image_data + 3 * (cy * PYRAMID_SCALE * width);
+    uint8_t *out = pyramid->coarseImage + 3 * (cy * pyramid->coarseWidth);
+
+    for (uint32_t cx = 0; cx < pyramid->coarseWidth; ++cx) {
+      uint32_t sum[3] = { 0, 0, 0 };
+
+      for (uint32_t dy = 0; dy < PYRAMID_SCALE; ++dy) {
+        const uint8_t *pixel = rows + 3 * (dy * width + cx * PYRAMID_SCALE);
+
+        for (uint32_t dx = 0; dx < 3 * PYRAMID_SCALE; dx += 3) {
+          sum[0] += pixel[dx];
+          sum[1] += pixel[dx + 1];
+          sum[2] += pixel[dx + 2];
+        }
+      }
+
+      out[3 * cx]     = (uint8_t)(sum[0] / (PYRAMID_SCALE * PYRAMID_SCALE));
+      out[3 * cx + 1] = (uint8_t)(sum[1] / (PYRAMID_SCALE * PYRAMID_SCALE));
+      out[3 * cx + 2] = (uint8_t)(sum[2] / (PYRAMID_SCALE * PYRAMID_SCALE));
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Tiles with coarse foreground, dilated by one tile
+// -----------------------------------------------------------------------------
+static void mark_active_tiles(vibePyramid_t *pyramid)
+{
+  uint32_t tilesPerRow = pyramid->tilesPerRow;
+  uint32_t tilesPerColumn = pyramid->tilesPerColumn;
+  uint32_t coarseTile = pyramid->tileSize / PYRAMID_SCALE;
+
+  memset(pyramid->activity, 0, tilesPerRow * tilesPerColumn);
+  for (uint32_t cy = 0; cy < pyramid->coarseHeight; ++cy) {
+    const uint8_t *map = pyramid->coarseMap + cy * pyramid->coarseWidth;
+    uint8_t *activity = pyramid->activity + (cy / coarseTile) * tilesPerRow;
+
+    for (uint32_t cx = 0; cx < pyramid->coarseWidth; ++cx)
+      activity[cx / coarseTile] |= map[cx];
+  }
+
+  /* The 8 neighbors of a tile with foreground are refined too, they hold its boundary. */
+  pyramid->activeTiles = 0;
+  for (uint32_t ty = 0; ty < tilesPerColumn; ++ty) {
+    uint32_t ty0 = (ty > 0) ? ty - 1 : 0;
+    uint32_t ty1 = (ty + 1 < tilesPerColumn) ? ty + 1 : ty;
+
+    for (uint32_t tx = 0; tx < tilesPerRow; ++tx) {
+      uint32_t tx0 = (tx > 0) ? tx - 1 : 0;
+      uint32_t tx1 = (tx + 1 < tilesPerRow) ? tx + 1 : tx;
+      uint8_t active = 0;
+
+      for (uint32_t y = ty0; y <= ty1; ++y)
+        for (uint32_t x = tx0; x <= tx1; ++x)
+          active |= pyramid->activity[x + y * tilesPerRow];
+
+      pyramid->dilated[tx + ty * tilesPerRow] = active;
+      pyramid->activeTiles += (active != 0);
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Creates the data structure
+// -----------------------------------------------------------------------------
+vibePyramid_t *libvibePyramid_New(const uint32_t tileSize)
+{
+  assert((tileSize > 0) && (tileSize % PYRAMID_SCALE == 0));
+
+  vibePyramid_t *pyramid = (vibePyramid_t*)calloc(1, sizeof(*pyramid));
+  assert(pyramid != NULL);
+
+  pyramid->tileSize = tileSize;
+  pyramid->fine = libvibeModel_Sequential_New();
+  pyramid->coarse = libvibeModel_Sequential_New();
+
+  return(pyramid);
+}
+
+// -----------------------------------------------------------------------------
+// Getters
+// -----------------------------------------------------------------------------
+uint32_t libvibePyramid_GetActiveTiles(const vibePyramid_t *pyramid)
+{
+  assert(pyramid != NULL); return(pyramid->activeTiles);
+}
+
+uint32_t libvibePyramid_GetNumberOfTiles(const vibePyramid_t *pyramid)
+{
+  assert(pyramid != NULL); return(pyramid->tilesPerRow * pyramid->tilesPerColumn);
+}
+
+vibeModel_Sequential_t *libvibePyramid_GetFineModel(vibePyramid_t *pyramid)
+{
+  assert(pyramid != NULL); return(pyramid->fine);
+}
+
+vibeModel_Sequential_t *libvibePyramid_GetCoarseModel(vibePyramid_t *pyramid)
+{
+  assert(pyramid != NULL); return(pyramid->coarse);
+}
+
+// ----------------------------------------------------------------------------
+// Frees the structure
+// ----------------------------------------------------------------------------
+int32_t libvibePyramid_Free(vibePyramid_t *pyramid)
+{
+  if (pyramid == NULL)
+    return(-1);
+
+  libvibeModel_Sequential_Free(pyramid->fine);
+  libvibeModel_Sequential_Free(pyramid->coarse);
+  free(pyramid->coarseImage);
+  free(pyramid->coarseMap);
+  free(pyramid->activity);
+  free(pyramid->dilated);
+  free(pyramid);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Allocates and initializes both models
+// -----------------------------------------------------------------------------
+int32_t libvibePyramid_AllocInit_8u_C3R(
+  vibePyramid_t *pyramid,
+  const uint8_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Some basic checks. */
+  assert((image_data != NULL) && (pyramid != NULL));
+  assert((width >= 2 * PYRAMID_SCALE) && (height >= 2 * PYRAMID_SCALE));
+
+  pyramid->width = width;
+  pyramid->height = height;
+  pyramid->coarseWidth = width / PYRAMID_SCALE;
+  pyramid->coarseHeight = height / PYRAMID_SCALE;
+
+  pyramid->coarseImage = (uint8_t*)malloc(3 * pyramid->coarseWidth * pyramid->coarseHeight);
+  assert(pyramid->coarseImage != NULL);
+
+  pyramid->coarseMap = (uint8_t*)malloc(pyramid->coarseWidth * pyramid->coarseHeight);
+  assert(pyramid->coarseMap != NULL);
+
+  pyramid->tilesPerRow = (width + pyramid->tileSize - 1) / pyramid->tileSize;
+  pyramid->tilesPerColumn = (height + pyramid->tileSize - 1) / pyramid->tileSize;
+
+  pyramid->activity = (uint8_t*)malloc(pyramid->tilesPerRow * pyramid->tilesPerColumn);
+  assert(pyramid->activity != NULL);
+
+  pyramid->dilated = (uint8_t*)malloc(pyramid->tilesPerRow * pyramid->tilesPerColumn);
+  assert(pyramid->dilated != NULL);
+
+  downscale_8u_C3R(pyramid, image_data);
+  libvibeModel_Sequential_AllocInit_8u_C3R(pyramid->fine, image_data, width, height);
+  libvibeModel_Sequential_AllocInit_8u_C3R(pyramid->coarse, pyramid->coarseImage, pyramid->coarseWidth, pyramid->coarseHeight);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Segmentation and update
+// -----------------------------------------------------------------------------
+int32_t libvibePyramid_Process_8u_C3R(
+  vibePyramid_t *pyramid,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (pyramid != NULL) && (segmentation_map != NULL));
+  assert(pyramid->coarseImage != NULL);
+
+  uint32_t width = pyramid->width;
+  uint32_t height = pyramid->height;
+  uint32_t tileSize = pyramid->tileSize;
+
+  /* Coarse level. */
+  downscale_8u_C3R(pyramid, image_data);
+  libvibeModel_Sequential_Segmentation_8u_C3R(pyramid->coarse, pyramid->coarseImage, pyramid->coarseMap);
+  libvibeModel_Sequential_Update_8u_C3R(pyramid->coarse, pyramid->coarseImage, pyramid->coarseMap);
+
+  mark_active_tiles(pyramid);
+
+  /* Fine level, consecutive active tiles of a row of tiles are classified at once. */
+  for (uint32_t ty = 0; ty < pyramid->tilesPerColumn; ++ty) {
+    const uint8_t *dilated = pyramid->dilated + ty * pyramid->tilesPerRow;
+    uint32_t y0 = ty * tileSize;
+    uint32_t y1 = (y0 + tileSize < height) ? y0 + tileSize : height;
+    uint32_t tx = 0;
+
+    while (tx < pyramid->tilesPerRow) {
+      uint32_t first = tx;
+      uint8_t active = dilated[tx];
+
+      while ((tx < pyramid->tilesPerRow) && (dilated[tx] == active))
+        ++tx;
+
+      uint32_t x0 = first * tileSize;
+      uint32_t x1 = (tx * tileSize < width) ? tx * tileSize : width;
+
+      if (active) {
+        libvibeModel_Sequential_SegmentationTile_8u_C3R(pyramid->fine, image_data, segmentation_map, x0, y0, x1, y1);
+      }
+      else {
+        for (uint32_t y = y0; y < y1; ++y)
+          memset(segmentation_map + y * width + x0, COLOR_BACKGROUND, x1 - x0);
+      }
+    }
+  }
+
+  /* The update only touches 1 pixel out of updateFactor, it keeps the idle tiles up to date. */
+  libvibeModel_Sequential_Update_8u_C3R(pyramid->fine, image_data, segmentation_map);
+
+  return(0);
+}
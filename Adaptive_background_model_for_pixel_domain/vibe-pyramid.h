@@ -0,0 +1,113 @@
+#ifndef _VIBE_PYRAMID_H_
+#define _VIBE_PYRAMID_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#include "vibe-background-sequential.h"
+
+/**
+ * \typedef struct vibePyramid_t
+ * \brief Coarse-to-fine C3R background subtraction.
+ *
+ * A second model runs on the frame downscaled by 4 in both directions. The
+ * full resolution model only classifies the tiles holding coarse foreground,
+ * and the tiles around them so that object boundaries are refined too; all
+ * other tiles are labelled background. The full resolution model is still
+ * updated over the whole frame, so idle tiles are ready when an object
+ * enters them.
+ *
+ * Objects smaller than a coarse pixel (4x4 pixels) can be missed.
+ */
+typedef struct vibePyramid vibePyramid_t;
+
+/**
+ * Allocation of a new pyramid. Models are only allocated by
+ * \ref libvibePyramid_AllocInit_8u_C3R.
+ *
+ * @param tileSize Side of the full resolution tiles, a multiple of 4.
+ * \result A pointer to a newly allocated \ref vibePyramid_t structure.
+ */
+vibePyramid_t *libvibePyramid_New(const uint32_t tileSize);
+
+/**
+ * Allocates and initializes both models with the first frame.
+ *
+ * @param pyramid
+ * @param image_data RGBRGB... pixels of width * height.
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibePyramid_AllocInit_8u_C3R(
+  vibePyramid_t *pyramid,
+  const uint8_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ * Classifies the frame into the full resolution *segmentation_map and
+ * updates both models.
+ *
+ * @param pyramid
+ * @param image_data
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibePyramid_Process_8u_C3R(
+  vibePyramid_t *pyramid,
+  const uint8_t *image_data,
+  uint8_t *segmentation_map
+);
+
+/**
+ * Getter.
+ *
+ * @param pyramid
+ * @return Number of tiles classified at full resolution by the last call to
+ * \ref libvibePyramid_Process_8u_C3R.
+ */
+uint32_t libvibePyramid_GetActiveTiles(const vibePyramid_t *pyramid);
+
+/**
+ * Getter.
+ *
+ * @param pyramid
+ * @return Number of tiles of the frame.
+ */
+uint32_t libvibePyramid_GetNumberOfTiles(const vibePyramid_t *pyramid);
+
+/**
+ * Getter, to change the parameters of the full resolution model.
+ *
+ * @param pyramid
+ * @return
+ */
+vibeModel_Sequential_t *libvibePyramid_GetFineModel(vibePyramid_t *pyramid);
+
+/**
+ * Getter, to change the parameters of the coarse model.
+ *
+ * @param pyramid
+ * @return
+ */
+vibeModel_Sequential_t *libvibePyramid_GetCoarseModel(vibePyramid_t *pyramid);
+
+/**
+ * \brief Frees both models and the pyramid.
+ *
+ * @param pyramid
+ * @return
+ */
+int32_t libvibePyramid_Free(vibePyramid_t *pyramid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,178 @@
+#include <math.h>
+#include "BlobSplitter.h"
+
+using namespace std;
+
+BlobSplitter::BlobSplitter(int min_area, int max_points, int min_part, float bandwidth, float mv_weight)
+    : min_area_(min_area), max_points_(max_points), min_part_(min_part),
+      bandwidth_(bandwidth), mv_weight_(mv_weight) {
+}
+
+void BlobSplitter::split_blob(Task &task, const ConnectedComponents &ccl, const BlobFeatures &features) const{
+    const Blob &blob = *task.blob;
+    const vector<ConnectedComponents::Run> &runs = ccl.runs();
+    task.parts.clear();
+
+    task.pixels.clear();
+    for (int k = run_start_[blob.label]; k < run_start_[blob.label + 1]; k++) {
+        const ConnectedComponents::Run &run = runs[run_index_[k]];
+        for (int x = run.start; x < run.end; x++) {
+            task.pixels.push_back(x);
+            task.pixels.push_back(run.row);
+        }
+    }
+    int area = task.pixels.size() / 2;
+
+    /* Features of one pixel out of step. The longest side of the blob spans one bandwidth, so that
+       a blob moving as a whole keeps a single mode. */
+    int step = (area + max_points_ - 1) / max_points_;
+    float spatial_weight = bandwidth_ / max(blob.x1 - blob.x0 + 1, blob.y1 - blob.y0 + 1);
+    task.points.clear();
+    for (int i = 0; i < area; i += step) {
+        int x = task.pixels[2 * i], y = task.pixels[2 * i + 1];
+        task.points.push_back(spatial_weight * (x - blob.x0));
+        task.points.push_back(spatial_weight * (y - blob.y0));
+        task.points.push_back(mv_weight_ * features.mv_x[y * features.mv_stride + x]);
+        task.points.push_back(mv_weight_ * features.mv_y[y * features.mv_stride + x]);
+    }
+    int n = task.points.size() / 4;
+    int count = task.engine.cluster(task.points.data(), n, bandwidth_, task.labels, task.modes);
+
+    /* Modes large enough to make an object. */
+    vector<int> sizes(count, 0);
+    for (int i = 0; i < n; i++)
+        sizes[task.labels[i]] += step;
+    int kept = 0;
+    for (int c = 0; c < count; c++)
+        if (sizes[c] >= min_part_) {
+            copy(&task.modes[4 * c], &task.modes[4 * c] + 4, &task.modes[4 * kept]);
+            kept++;
+        }
+    if (kept < 2)
+        return;
+
+    /* Every pixel goes to the nearest mode. */
+    int width = blob.x1 - blob.x0 + 1;
+    task.part.resize(area);
+    task.map.assign(width * (blob.y1 - blob.y0 + 1), 0);
+    for (int i = 0; i < area; i++) {
+        int x = task.pixels[2 * i], y = task.pixels[2 * i + 1];
+        float point[4] = { spatial_weight * (x - blob.x0), spatial_weight * (y - blob.y0),
+                           (float)(mv_weight_ * features.mv_x[y * features.mv_stride + x]),
+                           (float)(mv_weight_ * features.mv_y[y * features.mv_stride + x]) };
+        int best = 0;
+        float best_distance = MeanShift4D::distance_sqr(point, &task.modes[0]);
+        for (int c = 1; c < kept; c++) {
+            float distance = MeanShift4D::distance_sqr(point, &task.modes[4 * c]);
+            if (distance < best_distance) {
+                best = c;
+                best_distance = distance;
+            }
+        }
+        task.part[i] = best;
+        task.map[(y - blob.y0) * width + (x - blob.x0)] = best + 1;
+    }
+
+    /* Descriptors of the parts, as ConnectedComponents computes them. A pixel of a part is on its
+       perimeter when one of its 8 neighbors is not in the part. */
+    task.parts.assign(kept, Blob());
+    task.histograms.assign(9 * kept, 0);
+    for (int i = 0; i < area; i++) {
+        int x = task.pixels[2 * i], y = task.pixels[2 * i + 1];
+        Blob &b = task.parts[task.part[i]];
+        if (b.area == 0) {
+            b.x0 = b.x1 = x;
+            b.y0 = b.y1 = y;
+        }
+        b.area++;
+        b.x0 = min(b.x0, x);
+        b.x1 = max(b.x1, x);
+        b.y0 = min(b.y0, y);
+        b.y1 = max(b.y1, y);
+        b.cx += x;
+        b.cy += y;
+
+        int border = 0;
+        for (int v = y - 1; v <= y + 1 && !border; v++)
+            for (int u = x - 1; u <= x + 1 && !border; u++) {
+                bool inside = u >= blob.x0 && u <= blob.x1 && v >= blob.y0 && v <= blob.y1;
+                border = !inside || task.map[(v - blob.y0) * width + (u - blob.x0)] != task.part[i] + 1;
+            }
+        b.perimeter += border;
+
+        double mv_x = features.mv_x[y * features.mv_stride + x];
+        double mv_y = features.mv_y[y * features.mv_stride + x];
+        b.mv_x += mv_x;
+        b.mv_y += mv_y;
+        b.mv_length += sqrt(mv_x * mv_x + mv_y * mv_y);
+        b.bitsize += features.bitsize[y * features.stride + x];
+        task.histograms[9 * task.part[i] + features.direction[y * features.stride + x]]++;
+    }
+
+    for (int c = 0; c < kept; c++) {
+        Blob &b = task.parts[c];
+        const int *histogram = &task.histograms[9 * c];
+        b.label = blob.label;
+        b.cx /= b.area;
+        b.cy /= b.area;
+        b.mv_x /= b.area;
+        b.mv_y /= b.area;
+        b.mv_length /= b.area;
+        for (int d = 1; d < 9; d++)
+            if (histogram[d] > 0 && (b.direction == 0 || histogram[d] > histogram[b.direction]))
+                b.direction = d;
+    }
+}
+
+int BlobSplitter::split(ThreadPool *pool, const ConnectedComponents &ccl, const BlobFeatures &features,
+                        vector<Blob> &blobs){
+    /* Runs grouped by label. */
+    const vector<ConnectedComponents::Run> &runs = ccl.runs();
+    int labels = ccl.blobs().size();
+    run_start_.assign(labels + 2, 0);
+    for (size_t r = 0; r < runs.size(); r++)
+        run_start_[runs[r].label + 1]++;
+    for (int l = 1; l <= labels + 1; l++)
+        run_start_[l] += run_start_[l - 1];
+    run_index_.resize(runs.size());
+    for (size_t r = 0; r < runs.size(); r++)
+        run_index_[run_start_[runs[r].label]++] = r;
+    for (int l = labels + 1; l > 0; l--)
+        run_start_[l] = run_start_[l - 1];
+    run_start_[0] = 0;
+
+    /* One task per blob large enough. */
+    int count = 0;
+    for (size_t i = 0; i < blobs.size(); i++)
+        count += (blobs[i].area >= min_area_);
+    if (count == 0)
+        return 0;
+    if ((int)tasks_.size() < count)
+        tasks_.resize(count);
+    count = 0;
+    for (size_t i = 0; i < blobs.size(); i++)
+        if (blobs[i].area >= min_area_)
+            tasks_[count++].blob = &blobs[i];
+
+    if (pool != NULL && count > 1)
+        pool->parallel_for(count, [&](int t) { split_blob(tasks_[t], ccl, features); });
+    else
+        for (int t = 0; t < count; t++)
+            split_blob(tasks_[t], ccl, features);
+
+    /* Blobs in their order, each split blob replaced by its parts. */
+    int split = 0, t = 0;
+    output_.clear();
+    for (size_t i = 0; i < blobs.size(); i++) {
+        if (t < count && tasks_[t].blob == &blobs[i] && !tasks_[t].parts.empty()) {
+            output_.insert(output_.end(), tasks_[t].parts.begin(), tasks_[t].parts.end());
+            split++;
+        }
+        else
+            output_.push_back(blobs[i]);
+        if (t < count && tasks_[t].blob == &blobs[i])
+            t++;
+    }
+    blobs.swap(output_);
+    return split;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+
+#include "ConnectedComponents.h"
+#include "MeanShiftFlat.h"
+#include "ThreadPool.h"
+
+/*
+ * Splits the blobs that hold objects moving apart, e.g. two cars passing
+ * each other, which the 8-connected labeling merges into one blob.
+ *
+ * The pixels of a blob of at least min_area pixels are clustered with
+ * MeanShift on (x, y, mv_weight * mv_x, mv_weight * mv_y), the position
+ * scaled so that the blob spans one bandwidth: motion separates the parts,
+ * position only keeps apart the parts with the same motion far from each
+ * other. Modes holding fewer than min_part pixels are dropped, and when at
+ * least two modes remain, every pixel goes to the nearest one and the blob
+ * is replaced by one blob per mode, with its own descriptor.
+ *
+ * At most max_points pixels of a blob are clustered, taken at regular
+ * intervals, so the cost of a blob is bounded whatever its size. Blobs are
+ * independent and are split in parallel on the threads of a pool.
+ */
+class BlobSplitter {
+public:
+    BlobSplitter(int min_area = 256, int max_points = 256, int min_part = 64,
+                 float bandwidth = 4, float mv_weight = 0.25f);
+
+    /* Splits the blobs labelled by ccl with features, in place. blobs are those of ccl kept by the
+       caller, parts of a blob keep its label. pool may be NULL. Returns the number of blobs split. */
+    int split(ThreadPool *pool, const ConnectedComponents &ccl, const BlobFeatures &features,
+              std::vector<Blob> &blobs);
+
+private:
+    int min_area_;
+    int max_points_;
+    int min_part_;
+    float bandwidth_;
+    float mv_weight_;
+
+    /* Buffers of a blob, reused from frame to frame. */
+    struct Task {
+        const Blob *blob;
+        MeanShift4D engine;
+        std::vector<int> pixels;      /* x, y of every pixel. */
+        std::vector<float> points;    /* Features of the clustered pixels. */
+        std::vector<int> labels;
+        std::vector<float> modes;
+        std::vector<int> part;        /* Part of every pixel. */
+        std::vector<int> map;         /* Part + 1 of the pixels of the bounding box, 0 elsewhere. */
+        std::vector<int> histograms;  /* 9 direction bins per part. */
+        std::vector<Blob> parts;
+
+        Task() : blob(NULL), engine(3) {}
+    };
+    std::vector<Task> tasks_;
+    std::vector<int> run_start_;      /* Runs of every label, from ccl.runs(). */
+    std::vector<int> run_index_;
+    std::vector<Blob> output_;
+
+    void split_blob(Task &task, const ConnectedComponents &ccl, const BlobFeatures &features) const;
+};
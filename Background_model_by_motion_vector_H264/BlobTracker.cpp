@@ -0,0 +1,143 @@
+#include <math.h>
+#include <algorithm>
+#include "BlobTracker.h"
+
+using namespace std;
+
+static double iou(const Blob &b, const Track &t){
+    int w = min(b.x1, t.x1) - max(b.x0, t.x0) + 1;
+    int h = min(b.y1, t.y1) - max(b.y0, t.y0) + 1;
+    if (w <= 0 || h <= 0)
+        return 0;
+    double inter = (double)w * h;
+    double area_b = (double)(b.x1 - b.x0 + 1) * (b.y1 - b.y0 + 1);
+    double area_t = (double)(t.x1 - t.x0 + 1) * (t.y1 - t.y0 + 1);
+    return inter / (area_b + area_t - inter);
+}
+
+/* Floor division, cells of negative coordinates included. */
+static int cell_of(int x, int cell_size){
+    return (x >= 0) ? x / cell_size : -((-x + cell_size - 1) / cell_size);
+}
+
+BlobTracker::BlobTracker(int cell_size, double min_iou, double max_distance, int max_misses, double mv_scale)
+    : cell_size_(cell_size), min_iou_(min_iou), max_distance_(max_distance),
+      max_misses_(max_misses), mv_scale_(mv_scale), next_id_(1) {
+}
+
+void BlobTracker::predict(Track &track) const{
+    /* Motion vectors are measured on the blob itself, the last displacement is only a fallback. */
+    if (track.blob.mv_length > 0) {
+        track.vx = mv_scale_ * track.blob.mv_x;
+        track.vy = mv_scale_ * track.blob.mv_y;
+    }
+    int dx = (int)lround(track.vx * (track.misses + 1));
+    int dy = (int)lround(track.vy * (track.misses + 1));
+    track.x0 = track.blob.x0 + dx;
+    track.x1 = track.blob.x1 + dx;
+    track.y0 = track.blob.y0 + dy;
+    track.y1 = track.blob.y1 + dy;
+}
+
+const vector<Track> & BlobTracker::update(const vector<Blob> &blobs){
+    /* Predicted boxes of the tracks, in the cells they overlap. */
+    cells_.clear();
+    for (size_t t = 0; t < tracks_.size(); t++) {
+        Track &track = tracks_[t];
+        predict(track);
+        for (int cy = cell_of(track.y0, cell_size_); cy <= cell_of(track.y1, cell_size_); cy++)
+            for (int cx = cell_of(track.x0, cell_size_); cx <= cell_of(track.x1, cell_size_); cx++)
+                cells_[cell_key(cx, cy)].push_back(t);
+    }
+
+    /* Candidate pairs: tracks in the cells around every blob. */
+    candidates_.clear();
+    visited_.assign(tracks_.size(), -1);
+    int margin = (int)ceil(max_distance_);
+    for (size_t b = 0; b < blobs.size(); b++) {
+        const Blob &blob = blobs[b];
+        for (int cy = cell_of(blob.y0 - margin, cell_size_); cy <= cell_of(blob.y1 + margin, cell_size_); cy++)
+            for (int cx = cell_of(blob.x0 - margin, cell_size_); cx <= cell_of(blob.x1 + margin, cell_size_); cx++) {
+                unordered_map<long long, vector<int> >::const_iterator cell = cells_.find(cell_key(cx, cy));
+                if (cell == cells_.end())
+                    continue;
+
+                for (size_t i = 0; i < cell->second.size(); i++) {
+                    int t = cell->second[i];
+                    if (visited_[t] == (int)b)
+                        continue;
+                    visited_[t] = b;
+
+                    const Track &track = tracks_[t];
+                    double score = iou(blob, track);
+                    if (score < min_iou_) {
+                        /* No overlap, for small or fast blobs: closeness of the predicted centroid. */
+                        double px = track.blob.cx + track.vx * (track.misses + 1);
+                        double py = track.blob.cy + track.vy * (track.misses + 1);
+                        double distance = sqrt((blob.cx - px) * (blob.cx - px) + (blob.cy - py) * (blob.cy - py));
+                        if (distance > max_distance_)
+                            continue;
+                        score = min_iou_ * (1 - distance / (max_distance_ + 1));
+                    }
+
+                    Candidate candidate = { score, (int)b, t };
+                    candidates_.push_back(candidate);
+                }
+            }
+    }
+
+    /* Greedy assignment by decreasing score. */
+    sort(candidates_.begin(), candidates_.end());
+    blob_ids_.assign(blobs.size(), 0);
+    vector<bool> matched(tracks_.size(), false);
+    for (size_t c = 0; c < candidates_.size(); c++) {
+        const Candidate &candidate = candidates_[c];
+        if (matched[candidate.track] || blob_ids_[candidate.blob] != 0)
+            continue;
+
+        Track &track = tracks_[candidate.track];
+        const Blob &blob = blobs[candidate.blob];
+        if (blob.mv_length == 0) {
+            track.vx = (blob.cx - track.blob.cx) / (track.misses + 1);
+            track.vy = (blob.cy - track.blob.cy) / (track.misses + 1);
+        }
+        track.blob = blob;
+        track.age++;
+        track.misses = 0;
+        matched[candidate.track] = true;
+        blob_ids_[candidate.blob] = track.id;
+    }
+
+    /* Tracks lost for too long are dropped, the other ones wait for their blob. */
+    size_t kept = 0;
+    for (size_t t = 0; t < tracks_.size(); t++) {
+        if (!matched[t]) {
+            tracks_[t].age++;
+            if (++tracks_[t].misses > max_misses_)
+                continue;
+        }
+        tracks_[kept++] = tracks_[t];
+    }
+    tracks_.resize(kept);
+
+    /* New tracks for the blobs left. */
+    for (size_t b = 0; b < blobs.size(); b++) {
+        if (blob_ids_[b] != 0)
+            continue;
+
+        Track track;
+        track.id = next_id_++;
+        track.blob = blobs[b];
+        track.vx = track.vy = 0;
+        track.x0 = blobs[b].x0;
+        track.y0 = blobs[b].y0;
+        track.x1 = blobs[b].x1;
+        track.y1 = blobs[b].y1;
+        track.age = 1;
+        track.misses = 0;
+        tracks_.push_back(track);
+        blob_ids_[b] = track.id;
+    }
+
+    return tracks_;
+}
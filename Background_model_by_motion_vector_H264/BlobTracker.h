@@ -0,0 +1,64 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "ConnectedComponents.h"
+
+/*
+ * Frame-to-frame association of the blobs kept by filter().
+ *
+ * Every track predicts where its blob is in the next frame, from the mean
+ * motion vector of the blob when it moves and from its last displacement
+ * otherwise. Predicted boxes are stored in a uniform grid of cells, so that a
+ * blob is only compared with the tracks of the cells it overlaps: association
+ * is linear in the number of blobs for a bounded density of objects. Pairs are
+ * scored by the IoU of the boxes, or by the distance of the centroids when the
+ * boxes do not overlap enough, and assigned greedily by decreasing score.
+ */
+struct Track {
+    int id;             /* Stable identifier, never reused. */
+    Blob blob;          /* Last blob associated with the track. */
+    double vx, vy;      /* Displacement per frame, in pixels of the labelled grid. */
+    int x0, y0, x1, y1; /* Predicted box in the current frame. */
+    int age;            /* Frames since the track started. */
+    int misses;         /* Consecutive frames without a blob. */
+};
+
+class BlobTracker {
+public:
+    /* mv_scale converts a mean motion vector into a displacement on the labelled grid: the
+       default is for quarter-pel vectors pointing to the previous frame on a 4x4 block grid. */
+    BlobTracker(int cell_size = 16, double min_iou = 0.1, double max_distance = 8,
+                int max_misses = 5, double mv_scale = -1.0 / 16);
+
+    /* Associates the blobs of a new frame and returns the live tracks. */
+    const std::vector<Track> & update(const std::vector<Blob> &blobs);
+
+    const std::vector<Track> & tracks() const { return tracks_; }
+    /* Track id of every blob of the last call to update. */
+    const std::vector<int> & blob_ids() const { return blob_ids_; }
+
+private:
+    int cell_size_;
+    double min_iou_;
+    double max_distance_;
+    int max_misses_;
+    double mv_scale_;
+    int next_id_;
+
+    std::vector<Track> tracks_;
+    std::vector<int> blob_ids_;
+
+    struct Candidate {
+        double score;
+        int blob, track;
+        bool operator<(const Candidate &other) const { return score > other.score; }
+    };
+    std::vector<Candidate> candidates_;
+    std::unordered_map<long long, std::vector<int> > cells_;
+    std::vector<int> visited_;
+
+    long long cell_key(int cx, int cy) const { return ((long long)cx << 32) ^ (unsigned int)cy; }
+    void predict(Track &track) const;
+};
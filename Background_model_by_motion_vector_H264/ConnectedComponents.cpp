@@ -0,0 +1,304 @@
+#include <math.h>
+#include "ConnectedComponents.h"
+#include "MvQuantizer.h"
+
+using namespace std;
+
+typedef ConnectedComponents::Run Run;
+
+static int find_root(vector<int> &parent, int label){
+    int root = label;
+    while (parent[root] != root)
+        root = parent[root];
+    while (parent[label] != root) {
+        int next = parent[label];
+        parent[label] = root;
+        label = next;
+    }
+    return root;
+}
+
+static void unite(vector<int> &parent, int a, int b){
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    /* The smaller label becomes the root, so that parent[l] <= l always holds. */
+    if (a < b)
+        parent[b] = a;
+    else
+        parent[a] = b;
+}
+
+/* Consecutive final labels. Parents are smaller than their children, so one pass in
+   increasing order resolves them all. Returns the number of labels. */
+static int flatten(vector<int> &parent){
+    int count = 0;
+    for (size_t l = 1; l < parent.size(); l++)
+        parent[l] = (parent[l] == (int)l) ? ++count : parent[parent[l]];
+    return count;
+}
+
+/* Merges the labels of the runs [current, current_end) and the runs [previous, previous_end)
+   of the row above, touching in 8-connectivity. offset and previous_offset are added to their
+   labels. A run without label gets a new one. */
+static void connect_rows(vector<Run> &runs, int previous, int previous_end, int previous_offset,
+                         int current, int current_end, int offset, vector<int> &parent){
+    int p = previous;
+    for (int r = current; r < current_end; r++) {
+        Run &run = runs[r];
+
+        /* Runs of the previous row touching [start - 1, end]. */
+        while (p < previous_end && runs[p].end < run.start)
+            p++;
+        int q = p;
+        while (q < previous_end && runs[q].start <= run.end) {
+            if (run.label == 0 && offset == previous_offset)
+                run.label = runs[q].label;
+            else
+                unite(parent, run.label + offset, runs[q].label + previous_offset);
+            q++;
+        }
+        /* The last run touched can also touch the next run of this row. */
+        if (q > p)
+            p = q - 1;
+
+        if (run.label == 0) {
+            run.label = parent.size();
+            parent.push_back(run.label);
+        }
+    }
+}
+
+/* First scan of the rows [y0, y1): appends their runs to runs, with provisional labels of parent. */
+static void scan_runs(const int *image, int y0, int y1, int width, int stride, vector<Run> &runs, vector<int> &parent){
+    int previous_begin = runs.size(), previous_end = runs.size();
+    for (int y = y0; y < y1; y++) {
+        const int *row = image + y * stride;
+        int current_begin = runs.size();
+        int x = 0;
+
+        while (x < width) {
+            if (row[x] <= 0) {
+                x++;
+                continue;
+            }
+
+            Run run;
+            run.row = y;
+            run.start = x;
+            while (x < width && row[x] > 0)
+                x++;
+            run.end = x;
+            run.label = 0;
+            runs.push_back(run);
+        }
+
+        connect_rows(runs, previous_begin, previous_end, 0, current_begin, runs.size(), 0, parent);
+        previous_begin = current_begin;
+        previous_end = runs.size();
+    }
+}
+
+/* Adds a run to the sums of its blob. */
+static void accumulate(const Run &run, Blob &b, int *histogram,
+                       const int *image, int height, int width, int stride, const BlobFeatures *features){
+    if (b.area == 0) {
+        b.x0 = b.x1 = run.start;
+        b.y0 = b.y1 = run.row;
+    }
+    b.area += run.end - run.start;
+    if (run.start < b.x0) b.x0 = run.start;
+    if (run.end - 1 > b.x1) b.x1 = run.end - 1;
+    if (run.row < b.y0) b.y0 = run.row;
+    if (run.row > b.y1) b.y1 = run.row;
+    b.cx += (run.start + run.end - 1) * (run.end - run.start) / 2.0;
+    b.cy += (double)run.row * (run.end - run.start);
+
+    /* Perimeter: a neighbor of the run in the same row, or above and below it. */
+    const int *above = (run.row > 0) ? image + (run.row - 1) * stride : NULL;
+    const int *below = (run.row + 1 < height) ? image + (run.row + 1) * stride : NULL;
+    for (int x = run.start; x < run.end; x++) {
+        int border = (x == run.start && x > 0) || (x == run.end - 1 && x + 1 < width);
+        for (int u = (x > 0) ? x - 1 : x; !border && u <= x + 1 && u < width; u++)
+            border = (above != NULL && above[u] <= 0) || (below != NULL && below[u] <= 0);
+        b.perimeter += border;
+    }
+
+    if (features != NULL) {
+        const double *mv_x = features->mv_x + run.row * features->mv_stride;
+        const double *mv_y = features->mv_y + run.row * features->mv_stride;
+        const uint8_t *direction = features->direction + run.row * features->stride;
+        const uint16_t *bitsize = features->bitsize + run.row * features->stride;
+
+        for (int x = run.start; x < run.end; x++) {
+            b.mv_x += mv_x[x];
+            b.mv_y += mv_y[x];
+            b.mv_length += sqrt(mv_x[x] * mv_x[x] + mv_y[x] * mv_y[x]);
+            b.bitsize += bitsize[x];
+        }
+        MvQuantizer::histogram(direction + run.start, run.end - run.start, histogram);
+    }
+}
+
+/* Adds the sums of a part of a blob to another part, in any order. */
+static void merge(Blob &into, const Blob &from){
+    if (from.area == 0)
+        return;
+    if (into.area == 0) {
+        into = from;
+        return;
+    }
+    into.area += from.area;
+    into.perimeter += from.perimeter;
+    if (from.x0 < into.x0) into.x0 = from.x0;
+    if (from.y0 < into.y0) into.y0 = from.y0;
+    if (from.x1 > into.x1) into.x1 = from.x1;
+    if (from.y1 > into.y1) into.y1 = from.y1;
+    into.cx += from.cx;
+    into.cy += from.cy;
+    into.mv_x += from.mv_x;
+    into.mv_y += from.mv_y;
+    into.mv_length += from.mv_length;
+    into.bitsize += from.bitsize;
+}
+
+/* Turns the sums into means and picks the dominant direction. */
+static void finish(Blob &b, int label, const int *histogram, const BlobFeatures *features){
+    b.label = label;
+    b.cx /= b.area;
+    b.cy /= b.area;
+    if (features != NULL) {
+        b.mv_x /= b.area;
+        b.mv_y /= b.area;
+        b.mv_length /= b.area;
+
+        for (int d = 1; d < 9; d++)
+            if (histogram[d] > 0 && (b.direction == 0 || histogram[d] > histogram[b.direction]))
+                b.direction = d;
+    }
+}
+
+int ConnectedComponents::label(const int *image, int height, int width, int stride, const BlobFeatures *features){
+    /* First scan: runs and provisional labels. */
+    runs_.clear();
+    parent_.assign(1, 0);
+    scan_runs(image, 0, height, width, stride, runs_, parent_);
+    int count = flatten(parent_);
+
+    /* Second scan, on the runs: final labels and descriptors. */
+    blobs_.assign(count, Blob());
+    histograms_.assign(9 * count, 0);
+    for (size_t r = 0; r < runs_.size(); r++) {
+        Run &run = runs_[r];
+        run.label = parent_[run.label];
+        accumulate(run, blobs_[run.label - 1], &histograms_[9 * (run.label - 1)], image, height, width, stride, features);
+    }
+
+    for (int l = 0; l < count; l++)
+        finish(blobs_[l], l + 1, &histograms_[9 * l], features);
+
+    return count;
+}
+
+int ConnectedComponents::label(ThreadPool &pool, const int *image, int height, int width, int stride,
+                               const BlobFeatures *features, int strips){
+    if (strips <= 0)
+        strips = pool.size();
+    if (strips > height)
+        strips = height;
+    if (strips <= 1)
+        return label(image, height, width, stride, features);
+
+    /* Every strip is labelled on its own, with partial descriptors of its blobs. */
+    strips_.resize(strips);
+    pool.parallel_for(strips, [&](int s) {
+        Strip &strip = strips_[s];
+        strip.y0 = (long long)height * s / strips;
+        strip.y1 = (long long)height * (s + 1) / strips;
+
+        strip.runs.clear();
+        strip.parent.assign(1, 0);
+        scan_runs(image, strip.y0, strip.y1, width, stride, strip.runs, strip.parent);
+        strip.count = flatten(strip.parent);
+
+        strip.blobs.assign(strip.count, Blob());
+        strip.histograms.assign(9 * strip.count, 0);
+        for (size_t r = 0; r < strip.runs.size(); r++) {
+            Run &run = strip.runs[r];
+            run.label = strip.parent[run.label];
+            accumulate(run, strip.blobs[run.label - 1], &strip.histograms[9 * (run.label - 1)],
+                       image, height, width, stride, features);
+        }
+    });
+
+    /* The labels of strip s become offset + l. Blobs crossing a border are merged with the
+       runs of the last row of a strip and the first row of the next one. */
+    int total = 0;
+    for (int s = 0; s < strips; s++) {
+        strips_[s].offset = total;
+        total += strips_[s].count;
+    }
+
+    parent_.resize(total + 1);
+    for (int l = 0; l <= total; l++)
+        parent_[l] = l;
+
+    for (int s = 1; s < strips; s++) {
+        Strip &above = strips_[s - 1];
+        Strip &below = strips_[s];
+        int last = above.runs.size();
+        int first_end = 0;
+        while (last > 0 && above.runs[last - 1].row == above.y1 - 1)
+            last--;
+        while (first_end < (int)below.runs.size() && below.runs[first_end].row == below.y0)
+            first_end++;
+
+        /* connect_rows works on one vector, so the runs of the border rows are copied. */
+        border_.assign(above.runs.begin() + last, above.runs.end());
+        int previous_end = border_.size();
+        border_.insert(border_.end(), below.runs.begin(), below.runs.begin() + first_end);
+        connect_rows(border_, 0, previous_end, above.offset, previous_end, border_.size(), below.offset, parent_);
+    }
+
+    /* Parents are still smaller than their children, the labels are those of the sequential
+       scan: blobs are numbered by their first pixel in raster order. */
+    int count = flatten(parent_);
+
+    blobs_.assign(count, Blob());
+    histograms_.assign(9 * count, 0);
+    runs_.clear();
+    for (int s = 0; s < strips; s++) {
+        Strip &strip = strips_[s];
+        for (int l = 1; l <= strip.count; l++) {
+            int global = parent_[strip.offset + l];
+            merge(blobs_[global - 1], strip.blobs[l - 1]);
+            for (int d = 0; d < 9; d++)
+                histograms_[9 * (global - 1) + d] += strip.histograms[9 * (l - 1) + d];
+        }
+        for (size_t r = 0; r < strip.runs.size(); r++) {
+            runs_.push_back(strip.runs[r]);
+            runs_.back().label = parent_[strip.offset + strip.runs[r].label];
+        }
+    }
+
+    for (int l = 0; l < count; l++)
+        finish(blobs_[l], l + 1, &histograms_[9 * l], features);
+
+    return count;
+}
+
+int ConnectedComponents::filter_size(int *image, int stride, int size_min) const{
+    if (size_min <= 0)
+        return blobs_.size();
+
+    for (size_t r = 0; r < runs_.size(); r++) {
+        const Run &run = runs_[r];
+        if (blobs_[run.label - 1].area < size_min)
+            for (int x = run.start; x < run.end; x++)
+                image[run.row * stride + x] = 0;
+    }
+
+    int kept = 0;
+    for (size_t l = 0; l < blobs_.size(); l++)
+        kept += (blobs_[l].area >= size_min);
+    return kept;
+}
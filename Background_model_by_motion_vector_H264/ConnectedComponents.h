@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/*
+ * Run-length connected-component labeling with union-find (He, Chao and Suzuki,
+ * "A run-based two-scan labeling algorithm"), 8-connectivity.
+ *
+ * The first scan cuts every row into runs of foreground pixels and merges the
+ * provisional labels of runs touching a run of the previous row. The second
+ * scan only visits the runs: it resolves their final label and accumulates the
+ * descriptor of every blob. Memory is linear in the number of runs, no
+ * per-pixel mark array has to be cleared between frames.
+ *
+ * The parallel version labels horizontal strips on the threads of a pool,
+ * then merges the labels of the runs on both sides of every strip border and
+ * adds up the partial descriptors of the blobs. It gives the same labels and
+ * descriptors as the sequential one, up to the rounding of the sums.
+ */
+
+/* Feature planes read while labeling, on the same grid as the labelled image. */
+struct BlobFeatures {
+    const double *mv_x, *mv_y; /* Motion vector of every pixel, rows mv_stride apart. */
+    int mv_stride;
+    const uint8_t *direction;  /* Sector of the motion vector, 0 without motion and 1 to 8 (see calculate_angle). */
+    const uint16_t *bitsize;   /* Bits spent on the macroblock of every pixel. */
+    int stride;                /* Distance between the rows of direction and bitsize. */
+};
+
+struct Blob {
+    int label;
+    int x0, y0, x1, y1;    /* Bounding box, x1 and y1 included. */
+    int area;
+    int perimeter;         /* Pixels with a background pixel among their 8 neighbors. */
+    double cx, cy;         /* Centroid. */
+
+    /* Only filled when features are given to ConnectedComponents::label. */
+    int direction;         /* Most frequent sector among the moving pixels, 0 when none moves. */
+    double mv_x, mv_y;     /* Mean motion vector. */
+    double mv_length;      /* Mean length of the motion vectors. */
+    long long bitsize;     /* Sum over the pixels of the bitsize of their macroblock. */
+};
+
+class ConnectedComponents {
+public:
+    struct Run {
+        int row;
+        int start, end; /* Columns [start, end). */
+        int label;
+    };
+
+    /* Labels the pixels > 0 of a height x width image whose rows are stride ints apart and
+       describes every blob, using features when not NULL. Returns the number of blobs,
+       labelled from 1. */
+    int label(const int *image, int height, int width, int stride, const BlobFeatures *features = NULL);
+
+    /* Same, strip by strip on the threads of pool. strips <= 0 for one strip per thread. */
+    int label(ThreadPool &pool, const int *image, int height, int width, int stride,
+              const BlobFeatures *features = NULL, int strips = 0);
+
+    /* Sets to 0 the pixels of the blobs smaller than size_min (nothing when size_min <= 0).
+       Returns the number of blobs kept. */
+    int filter_size(int *image, int stride, int size_min) const;
+
+    const std::vector<Run> & runs() const { return runs_; }
+    /* Blob of label l is blobs()[l - 1]. */
+    const std::vector<Blob> & blobs() const { return blobs_; }
+
+private:
+    std::vector<Run> runs_;
+    std::vector<int> parent_;
+    std::vector<Blob> blobs_;
+    std::vector<int> histograms_; /* 9 direction bins per blob. */
+
+    /* Labeling of a strip: its own runs, labels and partial descriptors. */
+    struct Strip {
+        int y0, y1;
+        std::vector<Run> runs;
+        std::vector<int> parent;
+        std::vector<Blob> blobs;
+        std::vector<int> histograms;
+        int count;
+        int offset; /* Global label of the blob l of the strip is offset + l before merging. */
+    };
+    std::vector<Strip> strips_;
+    std::vector<Run> border_;
+};
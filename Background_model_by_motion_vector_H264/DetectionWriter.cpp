@@ -0,0 +1,118 @@
+#include <string.h>
+#include "DetectionWriter.h"
+
+using namespace std;
+
+static void put_varint(vector<uint8_t> &out, uint32_t value){
+    while (value >= 0x80) {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+DetectionWriter::DetectionWriter(size_t buffer_size)
+    : file_(NULL), width_(0), height_(0), buffer_size_(buffer_size), failed_(false) {
+}
+
+DetectionWriter::~DetectionWriter(){
+    close();
+}
+
+template <typename T> void DetectionWriter::put(T value){
+    size_t size = buffer_.size();
+    buffer_.resize(size + sizeof(value));
+    memcpy(&buffer_[size], &value, sizeof(value));
+}
+
+bool DetectionWriter::open(const char *filename, int width, int height){
+    close();
+    file_ = fopen(filename, "wb");
+    if (file_ == NULL)
+        return false;
+
+    width_ = width;
+    height_ = height;
+    failed_ = false;
+    buffer_.clear();
+    buffer_.reserve(buffer_size_);
+
+    put<uint32_t>(magic);
+    put<uint32_t>(version);
+    put<uint32_t>(width);
+    put<uint32_t>(height);
+    return flush();
+}
+
+void DetectionWriter::encode_mask(const int *mask, int stride){
+    runs_.clear();
+    bool foreground = false;
+    uint32_t length = 0;
+    for (int y = 0; y < height_; y++) {
+        const int *row = mask + y * stride;
+        for (int x = 0; x < width_; x++) {
+            if ((row[x] > 0) != foreground) {
+                put_varint(runs_, length);
+                foreground = !foreground;
+                length = 0;
+            }
+            length++;
+        }
+    }
+    put_varint(runs_, length);
+}
+
+bool DetectionWriter::write(int frame, const vector<Blob> &blobs, const vector<int> *ids, const int *mask, int stride){
+    if (file_ == NULL || failed_)
+        return false;
+
+    if (mask != NULL)
+        encode_mask(mask, stride);
+    else
+        runs_.clear();
+
+    put<uint32_t>(frame);
+    put<uint32_t>(blobs.size());
+    put<uint32_t>(runs_.size());
+
+    for (size_t i = 0; i < blobs.size(); i++) {
+        const Blob &b = blobs[i];
+        put<int32_t>((ids != NULL && i < ids->size()) ? (*ids)[i] : -1);
+        put<int32_t>(b.label);
+        put<int32_t>(b.x0);
+        put<int32_t>(b.y0);
+        put<int32_t>(b.x1);
+        put<int32_t>(b.y1);
+        put<int32_t>(b.area);
+        put<int32_t>(b.perimeter);
+        put<int32_t>(b.direction);
+        put<float>(b.cx);
+        put<float>(b.cy);
+        put<float>(b.mv_x);
+        put<float>(b.mv_y);
+        put<float>(b.mv_length);
+        put<int64_t>(b.bitsize);
+    }
+    buffer_.insert(buffer_.end(), runs_.begin(), runs_.end());
+
+    if (buffer_.size() >= buffer_size_)
+        return flush();
+    return true;
+}
+
+bool DetectionWriter::flush(){
+    if (!buffer_.empty() && fwrite(&buffer_[0], 1, buffer_.size(), file_) != buffer_.size())
+        failed_ = true;
+    buffer_.clear();
+    return !failed_;
+}
+
+bool DetectionWriter::close(){
+    if (file_ == NULL)
+        return true;
+
+    bool ok = flush();
+    ok = (fclose(file_) == 0) && ok;
+    file_ = NULL;
+    return ok;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "ConnectedComponents.h"
+
+/*
+ * Binary stream of the detections of every frame, in place of full masks.
+ *
+ * The file starts with a header: magic "VDET", version, width and height of
+ * the labelled grid (4 uint32). Every frame is then a record:
+ *   uint32 frame index, uint32 number of blobs, uint32 bytes of mask,
+ *   the blobs: int32 track id (-1 without tracker), label, x0, y0, x1, y1,
+ *   area, perimeter, direction, float cx, cy, mv_x, mv_y, mv_length,
+ *   int64 bitsize (64 bytes each),
+ *   the mask when there is one: lengths of the alternate runs of background
+ *   and foreground pixels in raster order, background first, as LEB128
+ *   varints.
+ * Values are in the byte order of the host. Records go through a buffer of
+ * buffer_size bytes, so the file sees a few large writes.
+ */
+class DetectionWriter {
+public:
+    static const uint32_t magic = 0x54454456; /* "VDET" */
+    static const uint32_t version = 1;
+
+    explicit DetectionWriter(size_t buffer_size = 1 << 16);
+    ~DetectionWriter();
+
+    /* Creates filename and writes the header. Returns false on error. */
+    bool open(const char *filename, int width, int height);
+
+    /* Appends the record of a frame. ids, when not NULL, holds the track id of every blob.
+       mask, when not NULL, is the width x height labelled image, rows stride ints apart,
+       foreground > 0. Returns false on error. */
+    bool write(int frame, const std::vector<Blob> &blobs, const std::vector<int> *ids = NULL,
+               const int *mask = NULL, int stride = 0);
+
+    /* Flushes the buffer and closes the file. Returns false on error. */
+    bool close();
+
+    bool is_open() const { return file_ != NULL; }
+
+private:
+    FILE *file_;
+    int width_, height_;
+    size_t buffer_size_;
+    std::vector<uint8_t> buffer_;
+    std::vector<uint8_t> runs_;
+    bool failed_;
+
+    DetectionWriter(const DetectionWriter &);
+    DetectionWriter & operator=(const DetectionWriter &);
+
+    template <typename T> void put(T value);
+    void encode_mask(const int *mask, int stride);
+    bool flush();
+};
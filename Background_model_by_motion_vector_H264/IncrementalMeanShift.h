@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "MeanShiftFlat.h"
+
+/*
+ * MeanShift clustering of a field that changes little from frame to frame,
+ * e.g. the motion vectors of the moving blocks.
+ *
+ * Every point belongs to a cell with a stable index (its block in the grid).
+ * A point whose cell held the same point in the previous frame keeps the
+ * position it converged to, and is not shifted again. A new or changed point
+ * starts from the nearest mode of the previous frame within a bandwidth, or
+ * from itself, so that it only has to travel the last part of its way.
+ * Every refresh_period frames, or when more than max_changed of the points
+ * changed, all the points are shifted again from their positions, so that the
+ * modes follow the slow changes of the density.
+ *
+ * Iterations are capped at twice what the previous frame needed (at least
+ * min_iterations, at most max_iterations): a frame that hits the cap raises
+ * it for the next one.
+ */
+template <int D>
+class IncrementalMeanShift {
+public:
+    IncrementalMeanShift(float bandwidth, float cutoff = 3, int refresh_period = 8,
+                         float max_changed = 0.5f, int min_iterations = 4, int max_iterations = 100)
+        : engine_(cutoff), bandwidth_(bandwidth), refresh_period_(refresh_period),
+          max_changed_(max_changed), min_iterations_(min_iterations), max_iterations_(max_iterations),
+          frame_(0), cap_(max_iterations), iterations_(0), shifted_points_(0) {}
+
+    /* Clusters the n points of D floats of a frame. cells[i], in [0, cell_count), is the cell
+       of points[i * D]. Returns the number of clusters. */
+    int update(const float *points, const int *cells, int n, int cell_count) {
+        if ((int)cell_frame_.size() != cell_count) {
+            cell_frame_.assign(cell_count, -1);
+            cell_point_.resize(cell_count * D);
+            cell_position_.resize(cell_count * D);
+        }
+
+        /* Starting positions, and the points to shift. */
+        positions_.resize(n * D);
+        subset_.clear();
+        for (int i = 0; i < n; i++) {
+            const float *point = points + i * D;
+            float *position = &positions_[i * D];
+            int c = cells[i];
+
+            if (cell_frame_[c] == frame_ - 1 && memcmp(&cell_point_[c * D], point, sizeof(float) * D) == 0) {
+                std::copy(&cell_position_[c * D], &cell_position_[c * D] + D, position);
+                continue;
+            }
+
+            const float *seed = point;
+            float best = bandwidth_ * bandwidth_;
+            for (size_t m = 0; m < modes_.size(); m += D)
+                if (MeanShiftFlat<D>::distance_sqr(point, &modes_[m]) <= best) {
+                    best = MeanShiftFlat<D>::distance_sqr(point, &modes_[m]);
+                    seed = &modes_[m];
+                }
+            std::copy(seed, seed + D, position);
+            subset_.push_back(i);
+        }
+
+        bool refresh = (refresh_period_ > 0 && frame_ % refresh_period_ == 0) || subset_.size() > max_changed_ * n;
+        if (refresh) {
+            subset_.resize(n);
+            for (int i = 0; i < n; i++)
+                subset_[i] = i;
+        }
+
+        shifted_points_ = subset_.size();
+        iterations_ = engine_.shift_positions(points, n, bandwidth_, positions_.data(), subset_.data(),
+                                              subset_.size(), 0.00001f, cap_);
+        if (!subset_.empty())
+            cap_ = std::min(std::max(2 * iterations_, min_iterations_), max_iterations_);
+
+        int count = engine_.group(positions_.data(), n, labels_, modes_);
+
+        for (int i = 0; i < n; i++) {
+            int c = cells[i];
+            cell_frame_[c] = frame_;
+            std::copy(points + i * D, points + i * D + D, &cell_point_[c * D]);
+            std::copy(&positions_[i * D], &positions_[i * D] + D, &cell_position_[c * D]);
+        }
+        frame_++;
+        return count;
+    }
+
+    /* Results of the last call to update: cluster of every point, D floats per mode. */
+    const std::vector<int> & labels() const { return labels_; }
+    const std::vector<float> & modes() const { return modes_; }
+
+    /* Iterations done and points shifted by the last call to update. */
+    int iterations() const { return iterations_; }
+    int shifted_points() const { return shifted_points_; }
+
+private:
+    MeanShiftFlat<D> engine_;
+    float bandwidth_;
+    int refresh_period_;
+    float max_changed_;
+    int min_iterations_, max_iterations_;
+
+    int frame_;
+    int cap_;
+    int iterations_;
+    int shifted_points_;
+
+    /* Last point of every cell, where it converged, and the frame it was seen in. */
+    std::vector<int> cell_frame_;
+    std::vector<float> cell_point_;
+    std::vector<float> cell_position_;
+
+    std::vector<float> positions_;
+    std::vector<int> subset_;
+    std::vector<int> labels_;
+    std::vector<float> modes_;
+};
@@ -0,0 +1,32 @@
+#include "JmReader.h"
+
+bool JmReader::open(const char *motion_filename, const char *bit_filename){
+    motion_.open(motion_filename);
+    bit_.open(bit_filename);
+    return motion_.is_open() && bit_.is_open();
+}
+
+void JmReader::close(){
+    motion_.close();
+    bit_.close();
+}
+
+bool JmReader::read_size(int &width, int &height){
+    bit_ >> width >> height;
+    motion_ >> width >> height;
+    return !bit_.fail() && !motion_.fail();
+}
+
+bool JmReader::read_frame(int mb_height, int mb_width, int *bit, int *type, int bit_stride,
+                          double *mv_x, double *mv_y, int mv_stride){
+    int index;
+    motion_ >> index;
+    bit_ >> index;
+    for (int i = 0; i < mb_height; i++)
+        for (int j = 0; j < mb_width; j++)
+            bit_ >> bit[i * bit_stride + j] >> type[i * bit_stride + j];
+    for (int i = 0; i < mb_height * 4; i++)
+        for (int j = 0; j < mb_width * 4; j++)
+            motion_ >> mv_x[i * mv_stride + j] >> mv_y[i * mv_stride + j];
+    return !bit_.fail() && !motion_.fail();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <fstream>
+
+/*
+ * Reader of the compressed-domain features dumped by the JM decoder, shared
+ * by the programs that run on them.
+ *
+ * Both files start with the width and height of the grid of 4x4 blocks.
+ * Every frame then starts with its index, followed in the BitSize file by the
+ * bitsize and type of every macroblock, and in the MV file by the motion
+ * vector (x then y, quarter-pel) of every 4x4 block, row by row.
+ */
+class JmReader {
+public:
+    /* Opens both files. Returns false when one of them cannot be opened. */
+    bool open(const char *motion_filename, const char *bit_filename);
+    void close();
+
+    /* Reads the size of the grid of 4x4 blocks from the headers. */
+    bool read_size(int &width, int &height);
+
+    /* Reads the features of a frame of mb_height x mb_width macroblocks: bit and type per
+       macroblock, rows bit_stride apart, and mv_x, mv_y per 4x4 block, 4 * mb_height rows of
+       4 * mb_width blocks, mv_stride apart. Returns false at the end of either file. */
+    bool read_frame(int mb_height, int mb_width, int *bit, int *type, int bit_stride,
+                    double *mv_x, double *mv_y, int mv_stride);
+
+private:
+    std::ifstream motion_;
+    std::ifstream bit_;
+};
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include <algorithm>
 #include "MeanShift.h"
 
 using namespace std;
@@ -29,12 +30,56 @@ double gaussian_kernel(double distance, double kernel_bandwidth){
     return temp;
 }
 
-void MeanShift::set_kernel( double (*_kernel_func)(double,double) ) {
+double flat_kernel(double distance, double kernel_bandwidth){
+    return (distance <= kernel_bandwidth) ? 1 : 0;
+}
+
+double epanechnikov_kernel(double distance, double kernel_bandwidth){
+    const double u = distance / kernel_bandwidth;
+    return (u <= 1) ? 1 - u*u : 0;
+}
+
+/* exp(-u/2) for u = (distance / bandwidth)^2 in [0, TRUNCATED_GAUSSIAN_SUPPORT^2], interpolated
+   linearly: the error stays below 3e-6. */
+#define TRUNCATED_GAUSSIAN_SUPPORT 3
+#define EXP_TABLE_SIZE 1024
+static double exp_table[EXP_TABLE_SIZE + 2];
+
+static bool fill_exp_table(){
+    const double step = (double)TRUNCATED_GAUSSIAN_SUPPORT * TRUNCATED_GAUSSIAN_SUPPORT / EXP_TABLE_SIZE;
+    for(int i=0; i<EXP_TABLE_SIZE + 2; i++){
+        exp_table[i] = exp(-0.5 * i * step);
+    }
+    return true;
+}
+static const bool exp_table_filled = fill_exp_table();
+
+double truncated_gaussian_kernel(double distance, double kernel_bandwidth){
+    const double u = (distance*distance) / (kernel_bandwidth*kernel_bandwidth);
+    if(u > TRUNCATED_GAUSSIAN_SUPPORT * TRUNCATED_GAUSSIAN_SUPPORT){
+        return 0;
+    }
+    const double x = u * (EXP_TABLE_SIZE / (double)(TRUNCATED_GAUSSIAN_SUPPORT * TRUNCATED_GAUSSIAN_SUPPORT));
+    const int i = (int)x;
+    return exp_table[i] + (x - i) * (exp_table[i+1] - exp_table[i]);
+}
+
+void MeanShift::set_kernel( double (*_kernel_func)(double,double), double _support ) {
+    (void)exp_table_filled;
     if(!_kernel_func){
         kernel_func = gaussian_kernel;
     } else {
         kernel_func = _kernel_func;    
     }
+
+    support = _support;
+    if(support <= 0){
+        if(kernel_func == flat_kernel || kernel_func == epanechnikov_kernel){
+            support = 1;
+        } else if(kernel_func == truncated_gaussian_kernel){
+            support = TRUNCATED_GAUSSIAN_SUPPORT;
+        }
+    }
 }
 
 void MeanShift::shift_point(const Point &point,
@@ -56,60 +101,275 @@ void MeanShift::shift_point(const Point &point,
         total_weight += weight;
     }
 
+    /* Only with a kernel of bounded support: nothing left around the point. */
+    if(total_weight == 0){
+        shifted_point = point;
+        return;
+    }
     const double total_weight_inv = 1.0/total_weight;
     for(int i=0; i<shifted_point.size(); i++){
         shifted_point[i] *= total_weight_inv;
     }
 }
 
+bool MeanShift::build_grid(const std::vector<Point> &points, double cell_size){
+    if(points.empty() || !(cell_size > 0)){
+        return false;
+    }
+    const int dims = points[0].size();
+    const int n = points.size();
+    grid.cell_size = cell_size;
+    grid.origin = points[0];
+    vector<double> top = points[0];
+    for(int i=1; i<n; i++){
+        for(int d=0; d<dims; d++){
+            grid.origin[d] = min(grid.origin[d], points[i][d]);
+            top[d] = max(top[d], points[i][d]);
+        }
+    }
+
+    /* Row-major numbering of the cells, the grid is not used when it does not fit. */
+    grid.cells.resize(dims);
+    double total = 1;
+    for(int d=0; d<dims; d++){
+        grid.cells[d] = (long long)floor((top[d] - grid.origin[d]) / cell_size) + 1;
+        total *= grid.cells[d];
+    }
+    if(total > 1e15){
+        return false;
+    }
+
+    vector<pair<long long,int> > keys(n);
+    for(int i=0; i<n; i++){
+        long long key = 0;
+        for(int d=0; d<dims; d++){
+            long long c = (long long)floor((points[i][d] - grid.origin[d]) / cell_size);
+            key = key * grid.cells[d] + min(c, grid.cells[d] - 1);
+        }
+        keys[i] = make_pair(key, i);
+    }
+    sort(keys.begin(), keys.end());
+
+    grid.index.resize(n);
+    grid.ranges.clear();
+    for(int i=0; i<n; i++){
+        grid.index[i] = keys[i].second;
+        if(i == 0 || keys[i].first != keys[i-1].first){
+            grid.ranges[keys[i].first] = make_pair(i, i);
+        }
+        grid.ranges[keys[i].first].second = i + 1;
+    }
+    return true;
+}
+
+/* Same as shift_point, over the points of the 3^dims cells around the point that are closer
+   than the cell size. */
+void MeanShift::shift_point_grid(const Point &point,
+                                 const std::vector<Point> &points,
+                                 double kernel_bandwidth,
+                                 Point &shifted_point) {
+    const int dims = point.size();
+    const double cutoff_sqr = grid.cell_size * grid.cell_size;
+    shifted_point.assign(dims, 0);
+
+    /* Cells [lo, hi] along every dimension, visited as an odometer. */
+    vector<long long> lo(dims), hi(dims), c(dims);
+    for(int d=0; d<dims; d++){
+        long long cell = (long long)floor((point[d] - grid.origin[d]) / grid.cell_size);
+        lo[d] = max(cell - 1, 0LL);
+        hi[d] = min(cell + 1, grid.cells[d] - 1);
+        if(lo[d] > hi[d]){
+            shifted_point = point;
+            return;
+        }
+        c[d] = lo[d];
+    }
+
+    double total_weight = 0;
+    for(;;){
+        long long key = 0;
+        for(int d=0; d<dims; d++){
+            key = key * grid.cells[d] + c[d];
+        }
+        unordered_map<long long, pair<int,int> >::const_iterator cell = grid.ranges.find(key);
+        if(cell != grid.ranges.end()){
+            for(int k=cell->second.first; k<cell->second.second; k++){
+                const Point& temp_point = points[grid.index[k]];
+                double distance_sqr = euclidean_distance_sqr(point, temp_point);
+                if(distance_sqr > cutoff_sqr){
+                    continue;
+                }
+                double weight = kernel_func(sqrt(distance_sqr), kernel_bandwidth);
+                for(int j=0; j<dims; j++){
+                    shifted_point[j] += temp_point[j] * weight;
+                }
+                total_weight += weight;
+            }
+        }
+
+        int d = dims - 1;
+        while(d >= 0 && c[d] == hi[d]){
+            c[d] = lo[d];
+            d--;
+        }
+        if(d < 0){
+            break;
+        }
+        c[d]++;
+    }
+
+    if(total_weight == 0){
+        shifted_point = point;
+        return;
+    }
+    const double total_weight_inv = 1.0/total_weight;
+    for(int i=0; i<dims; i++){
+        shifted_point[i] *= total_weight_inv;
+    }
+}
+
+/* One iteration over the points [begin, end) that still move. Returns the largest squared shift. */
+double MeanShift::shift_points(const std::vector<Point> &points,
+                               double kernel_bandwidth,
+                               double EPSILON_SQR,
+                               bool indexed,
+                               int begin, int end,
+                               std::vector<Point> &shifted_points,
+                               std::vector<char> &stop_moving){
+    double max_shift_distance = 0;
+    Point point_new;
+    for(int i=begin; i<end; i++){
+        if (!stop_moving[i]) {
+            if (indexed)
+                shift_point_grid(shifted_points[i], points, kernel_bandwidth, point_new);
+            else
+                shift_point(shifted_points[i], points, kernel_bandwidth, point_new);
+            double shift_distance_sqr = euclidean_distance_sqr(point_new, shifted_points[i]);
+            if(shift_distance_sqr > max_shift_distance){
+                max_shift_distance = shift_distance_sqr;
+            }
+            if(shift_distance_sqr <= EPSILON_SQR) {
+                stop_moving[i] = true;
+            }
+            shifted_points[i].swap(point_new);
+        }
+    }
+    return max_shift_distance;
+}
+
 std::vector<MeanShift::Point> MeanShift::meanshift(const std::vector<Point> &points,
                                              double kernel_bandwidth,
                                              double EPSILON){
     const double EPSILON_SQR = EPSILON*EPSILON;
-    vector<bool> stop_moving(points.size(), false);
+    const int n = points.size();
+    vector<char> stop_moving(n, false);
     vector<Point> shifted_points = points;
     double max_shift_distance;
-    Point point_new;
+    /* The cutoff, or else the support of the kernel, bounds the neighbors. */
+    const double radius = (cutoff > 0) ? cutoff : support;
+    bool indexed = radius > 0 && build_grid(points, radius * kernel_bandwidth);
+
+    /* Every point only reads the original points, the chunks are independent. Several chunks
+       per thread even out the points that stop moving early. */
+    const int chunks = (pool != NULL) ? min(n, 4 * pool->size()) : 1;
+    vector<double> chunk_max(chunks);
+
     int ccc = 0;
     do {
         ccc++;
-        max_shift_distance = 0;
-        for(int i=0; i<points.size(); i++){
-            if (!stop_moving[i]) {
-                shift_point(shifted_points[i], points, kernel_bandwidth, point_new);
-                double shift_distance_sqr = euclidean_distance_sqr(point_new, shifted_points[i]);
-                if(shift_distance_sqr > max_shift_distance){
-                    max_shift_distance = shift_distance_sqr;
-                }
-                if(shift_distance_sqr <= EPSILON_SQR) {
-                    stop_moving[i] = true;
-                }
-                shifted_points[i] = point_new;
-            }
+        if (chunks > 1) {
+            pool->parallel_for(chunks, [&](int c) {
+                chunk_max[c] = shift_points(points, kernel_bandwidth, EPSILON_SQR, indexed,
+                                            (long long)n * c / chunks, (long long)n * (c + 1) / chunks,
+                                            shifted_points, stop_moving);
+            });
+            max_shift_distance = *max_element(chunk_max.begin(), chunk_max.end());
+        }
+        else {
+            max_shift_distance = shift_points(points, kernel_bandwidth, EPSILON_SQR, indexed,
+                                              0, n, shifted_points, stop_moving);
+        }
+        if (progress != NULL) {
+            progress(ccc, sqrt(max_shift_distance), progress_arg);
         }
-        printf("max_shift_distance: %f\n", sqrt(max_shift_distance));
     } while (max_shift_distance > EPSILON_SQR&& ccc<100);
     return shifted_points;
 }
 
+static size_t cell_hash(const vector<long long> &cell){
+    size_t hash = 0;
+    for(size_t d=0; d<cell.size(); d++){
+        hash = hash * 1000003 ^ (size_t)cell[d];
+    }
+    return hash;
+}
+
+/* A point joins the first cluster whose mode is within CLUSTER_EPSILON. Modes are hashed by
+   their cell of side CLUSTER_EPSILON, so these clusters are among those of the 3^dims cells
+   around the point: the lowest index found there is the one of the linear scan. Collisions
+   only add candidates, which are checked anyway. The scan remains when it is shorter. */
 vector<Cluster> MeanShift::cluster(const std::vector<Point> &points,
     const std::vector<Point> &shifted_points)
 {
     vector<Cluster> clusters;
+    const int dims = shifted_points.empty() ? 0 : shifted_points[0].size();
+    vector<long long> cell(dims), neighbor(dims);
+    double neighbor_cells = 1;
+    for (int d = 0; d < dims; d++) {
+        neighbor_cells *= 3;
+    }
+    mode_cells.clear();
 
-    for (int i = 0; i < shifted_points.size(); i++) {
+    const int n = shifted_points.size();
+    for (int i = 0; i < n; i++) {
+        const Point &point = shifted_points[i];
+        const int count = clusters.size();
 
         int c = 0;
-        for (; c < clusters.size(); c++) {
-            if (euclidean_distance(shifted_points[i], clusters[c].mode) <= CLUSTER_EPSILON) {
-                break;
+        if (neighbor_cells >= count) {
+            for (; c < count; c++) {
+                if (euclidean_distance(point, clusters[c].mode) <= CLUSTER_EPSILON) {
+                    break;
+                }
+            }
+        }
+        else {
+            c = count;
+            for (int d = 0; d < dims; d++) {
+                cell[d] = (long long)floor(point[d] / CLUSTER_EPSILON);
+                neighbor[d] = cell[d] - 1;
+            }
+            for (;;) {
+                unordered_map<size_t, vector<int> >::const_iterator modes = mode_cells.find(cell_hash(neighbor));
+                if (modes != mode_cells.end()) {
+                    for (size_t k = 0; k < modes->second.size(); k++) {
+                        int m = modes->second[k];
+                        if (m < c && euclidean_distance(point, clusters[m].mode) <= CLUSTER_EPSILON) {
+                            c = m;
+                        }
+                    }
+                }
+
+                int d = dims - 1;
+                while (d >= 0 && neighbor[d] == cell[d] + 1) {
+                    neighbor[d] = cell[d] - 1;
+                    d--;
+                }
+                if (d < 0) {
+                    break;
+                }
+                neighbor[d]++;
             }
         }
 
-        if (c == clusters.size()) {
+        if (c == count) {
             Cluster clus;
-            clus.mode = shifted_points[i];
+            clus.mode = point;
             clusters.push_back(clus);
+            for (int d = 0; d < dims; d++) {
+                cell[d] = (long long)floor(point[d] / CLUSTER_EPSILON);
+            }
+            mode_cells[cell_hash(cell)].push_back(c);
         }
 
         clusters[c].original_points.push_back(points[i]);
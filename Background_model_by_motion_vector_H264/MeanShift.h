@@ -1,7 +1,17 @@
 #pragma once 
 
+#include <stddef.h>
+#include <unordered_map>
 #include <vector>
 
+#include "ThreadPool.h"
+
+/* Built-in kernels, weight of a point at distance from the point being shifted. */
+double gaussian_kernel(double distance, double kernel_bandwidth);
+double flat_kernel(double distance, double kernel_bandwidth);             /* 1 within the bandwidth. */
+double epanechnikov_kernel(double distance, double kernel_bandwidth);     /* 1 - (distance / bandwidth)^2 within the bandwidth. */
+double truncated_gaussian_kernel(double distance, double kernel_bandwidth); /* Gaussian within 3 bandwidths, from a table. */
+
 struct Cluster {
     std::vector<double> mode;
     std::vector<std::vector<double> > original_points;
@@ -12,16 +22,55 @@ class MeanShift {
 public:
     typedef std::vector<double> Point;
 
-    MeanShift() { set_kernel(NULL); }
-    MeanShift(double (*_kernel_func)(double,double)) { set_kernel(kernel_func); }
+    /* Called after every iteration of meanshift with the largest shift of the iteration. */
+    typedef void (*ProgressFunc)(int iteration, double max_shift_distance, void *arg);
+
+    MeanShift() : cutoff(0), pool(NULL), progress(NULL), progress_arg(NULL) { set_kernel(NULL); }
+    /* support: distance in bandwidths beyond which _kernel_func is 0, 0 when it never is. A
+       kernel with a support only visits the points within it, as set_cutoff does. Supports of
+       the built-in kernels are known, e.g. MeanShift(epanechnikov_kernel). */
+    MeanShift(double (*_kernel_func)(double,double), double support = 0)
+        : cutoff(0), pool(NULL), progress(NULL), progress_arg(NULL) { set_kernel(_kernel_func, support); }
     std::vector<Point> meanshift(const std::vector<Point> & points,
                                                 double kernel_bandwidth,
                                                 double EPSILON = 0.00001);
     std::vector<Cluster> cluster(const std::vector<Point> &, double);
 
+    /* Only the points closer than bandwidths * kernel_bandwidth are weighted, found through
+       a uniform grid of cells of that size rebuilt by every call to meanshift. 0 for the
+       support of the kernel, every point when it has none. */
+    void set_cutoff(double bandwidths) { cutoff = bandwidths; }
+
+    /* Shifts the points of an iteration in chunks on the threads of _pool, NULL for the
+       calling thread only. Results do not depend on the number of threads. */
+    void set_thread_pool(ThreadPool *_pool) { pool = _pool; }
+
+    /* Reports the progress of meanshift to _progress, NULL for no report. */
+    void set_progress(ProgressFunc _progress, void *arg = NULL) { progress = _progress; progress_arg = arg; }
+
 private:
     double (*kernel_func)(double,double);
-    void set_kernel(double (*_kernel_func)(double,double));
+    double support;
+    double cutoff;
+    ThreadPool *pool;
+    ProgressFunc progress;
+    void *progress_arg;
+
+    /* Uniform grid over the points: the cells of the bounding box, numbered in row-major
+       order, and the points of every non empty cell as a range of index. */
+    struct Grid {
+        double cell_size;
+        std::vector<double> origin;
+        std::vector<long long> cells; /* Cells along every dimension. */
+        std::unordered_map<long long, std::pair<int,int> > ranges;
+        std::vector<int> index;
+    } grid;
+    bool build_grid(const std::vector<Point> &, double);
+    void shift_point_grid(const Point&, const std::vector<Point> &, double, Point&);
+    double shift_points(const std::vector<Point> &, double, double, bool, int, int,
+                        std::vector<Point> &, std::vector<char> &);
+    void set_kernel(double (*_kernel_func)(double,double), double _support = 0);
     void shift_point(const Point&, const std::vector<Point> &, double, Point&);
     std::vector<Cluster> cluster(const std::vector<Point> &, const std::vector<Point> &);
+    std::unordered_map<size_t, std::vector<int> > mode_cells; /* Clusters by cell of their mode. */
 };
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * MeanShift over a flat buffer of points of D floats, stored one after the
+ * other. Same Gaussian kernel, stopping rule and mode grouping as
+ * MeanShift::cluster, but the points are never copied one by one: the
+ * shifted points live in one buffer reused from call to call, and the
+ * result is a cluster label per point plus D floats per mode. With D known
+ * at compile time the kernel loop is unrolled and vectorized.
+ *
+ * Use MeanShift2D, MeanShift3D or MeanShift4D, e.g. for (x, y), (mv_x, mv_y,
+ * length) or (x, y, mv_x, mv_y).
+ */
+template <int D>
+class MeanShiftFlat {
+public:
+    static_assert(D >= 2 && D <= 4, "MeanShiftFlat is for 2 to 4 dimensions");
+
+    static constexpr float cluster_epsilon = 0.5f;
+
+    /* See MeanShift::set_cutoff. */
+    explicit MeanShiftFlat(float cutoff = 0) : cutoff_(cutoff) {}
+    void set_cutoff(float bandwidths) { cutoff_ = bandwidths; }
+
+    /* Shifts the n points to their modes, then groups the modes closer than cluster_epsilon.
+       labels[i] is the cluster of points[i * D], modes holds D floats per cluster in the order
+       of their first point. Returns the number of clusters. */
+    int cluster(const float *points, int n, float bandwidth,
+                std::vector<int> &labels, std::vector<float> &modes,
+                float epsilon = 0.00001f, int max_iterations = 100) {
+        shifted_.assign(points, points + n * D);
+        shift_positions(points, n, bandwidth, shifted_.data(), NULL, n, epsilon, max_iterations);
+        return group(shifted_.data(), n, labels, modes);
+    }
+
+    /* Moves positions[subset[k] * D] for k < m, or the m first positions when subset is NULL,
+       up the density of the n points, until they move by less than epsilon or for
+       max_iterations. Returns the number of iterations done. */
+    int shift_positions(const float *points, int n, float bandwidth, float *positions,
+                        const int *subset, int m, float epsilon = 0.00001f, int max_iterations = 100) {
+        moving_.assign(m, 1);
+        indexed_ = cutoff_ > 0 && build_grid(points, n, cutoff_ * bandwidth);
+
+        float epsilon_sqr = epsilon * epsilon;
+        float max_shift;
+        int iterations = 0;
+        if (m == 0)
+            return 0;
+        do {
+            iterations++;
+            max_shift = 0;
+            for (int k = 0; k < m; k++) {
+                if (!moving_[k])
+                    continue;
+                float *position = positions + (subset != NULL ? subset[k] : k) * D;
+                float point_new[D];
+                shift(position, points, n, bandwidth, point_new);
+                float shift_sqr = distance_sqr(point_new, position);
+                max_shift = std::max(max_shift, shift_sqr);
+                if (shift_sqr <= epsilon_sqr)
+                    moving_[k] = 0;
+                std::copy(point_new, point_new + D, position);
+            }
+        } while (max_shift > epsilon_sqr && iterations < max_iterations);
+        return iterations;
+    }
+
+    /* Groups the n positions closer than cluster_epsilon, as cluster does: a position joins the
+       first mode within cluster_epsilon. Modes are hashed by their cell of side cluster_epsilon,
+       as in MeanShift::cluster, so only those of the 3^D cells around a position are checked;
+       the scan of all the modes remains while it is shorter. */
+    int group(const float *positions, int n, std::vector<int> &labels, std::vector<float> &modes) {
+        labels.resize(n);
+        modes.clear();
+        mode_cells_.clear();
+        int neighbor_cells = 1;
+        for (int d = 0; d < D; d++)
+            neighbor_cells *= 3;
+
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            const float *p = positions + i * D;
+            long long cell[D], neighbor[D];
+            for (int d = 0; d < D; d++) {
+                cell[d] = (long long)floorf(p[d] / cluster_epsilon);
+                neighbor[d] = cell[d] - 1;
+            }
+
+            int c = 0;
+            if (neighbor_cells >= count) {
+                for (; c < count; c++)
+                    if (distance_sqr(p, &modes[c * D]) <= cluster_epsilon * cluster_epsilon)
+                        break;
+            }
+            else {
+                c = count;
+                for (;;) {
+                    std::unordered_map<size_t, std::vector<int> >::const_iterator found =
+                        mode_cells_.find(cell_hash(neighbor));
+                    if (found != mode_cells_.end())
+                        for (size_t k = 0; k < found->second.size(); k++) {
+                            int m = found->second[k];
+                            if (m < c && distance_sqr(p, &modes[m * D]) <= cluster_epsilon * cluster_epsilon)
+                                c = m;
+                        }
+
+                    int d = D - 1;
+                    while (d >= 0 && neighbor[d] == cell[d] + 1) {
+                        neighbor[d] = cell[d] - 1;
+                        d--;
+                    }
+                    if (d < 0)
+                        break;
+                    neighbor[d]++;
+                }
+            }
+
+            if (c == count) {
+                modes.insert(modes.end(), p, p + D);
+                mode_cells_[cell_hash(cell)].push_back(c);
+                count++;
+            }
+            labels[i] = c;
+        }
+        return count;
+    }
+
+    static float distance_sqr(const float *a, const float *b) {
+        float total = 0;
+        for (int d = 0; d < D; d++)
+            total += (a[d] - b[d]) * (a[d] - b[d]);
+        return total;
+    }
+
+    /* Points shifted by the last call to cluster, D floats each. */
+    const std::vector<float> & shifted() const { return shifted_; }
+
+private:
+    float cutoff_;
+    std::vector<float> shifted_;
+    std::vector<unsigned char> moving_;
+
+    /* Modes by cell of side cluster_epsilon, for group. */
+    std::unordered_map<size_t, std::vector<int> > mode_cells_;
+
+    static size_t cell_hash(const long long *cell) {
+        size_t hash = 0;
+        for (int d = 0; d < D; d++)
+            hash = hash * 1000003 ^ (size_t)cell[d];
+        return hash;
+    }
+
+    /* Uniform grid of the points, as in MeanShift. */
+    bool indexed_;
+    float cell_size_;
+    float origin_[D];
+    long long cells_[D];
+    std::vector<std::pair<long long, int> > keys_;
+    std::vector<int> index_;
+    std::unordered_map<long long, std::pair<int, int> > ranges_;
+
+    long long cell_of(const float *p, int d) const {
+        return (long long)floorf((p[d] - origin_[d]) / cell_size_);
+    }
+
+    bool build_grid(const float *points, int n, float cell_size) {
+        if (n == 0 || !(cell_size > 0))
+            return false;
+
+        float top[D];
+        for (int d = 0; d < D; d++)
+            origin_[d] = top[d] = points[d];
+        for (int i = 1; i < n; i++)
+            for (int d = 0; d < D; d++) {
+                origin_[d] = std::min(origin_[d], points[i * D + d]);
+                top[d] = std::max(top[d], points[i * D + d]);
+            }
+
+        cell_size_ = cell_size;
+        double total = 1;
+        for (int d = 0; d < D; d++) {
+            cells_[d] = cell_of(top, d) + 1;
+            total *= cells_[d];
+        }
+        if (total > 1e15)
+            return false;
+
+        keys_.resize(n);
+        for (int i = 0; i < n; i++) {
+            long long key = 0;
+            for (int d = 0; d < D; d++)
+                key = key * cells_[d] + std::min(cell_of(points + i * D, d), cells_[d] - 1);
+            keys_[i] = std::make_pair(key, i);
+        }
+        std::sort(keys_.begin(), keys_.end());
+
+        index_.resize(n);
+        ranges_.clear();
+        for (int i = 0; i < n; i++) {
+            index_[i] = keys_[i].second;
+            if (i == 0 || keys_[i].first != keys_[i - 1].first)
+                ranges_[keys_[i].first] = std::make_pair(i, i);
+            ranges_[keys_[i].first].second = i + 1;
+        }
+        return true;
+    }
+
+    /* Adds the weighted points of index_[begin, end), or of [begin, end) without index. */
+    void accumulate(const float *point, const float *points, int begin, int end, const int *index,
+                    float scale, float cutoff_sqr, double *sum, double &total_weight) const {
+        for (int k = begin; k < end; k++) {
+            const float *q = points + (index != NULL ? index[k] : k) * D;
+            float distance = distance_sqr(point, q);
+            /* Below e^-80 the weight would be a denormal float: slow and negligible. */
+            if (distance > cutoff_sqr || scale * distance < -80)
+                continue;
+            float weight = expf(scale * distance);
+            for (int d = 0; d < D; d++)
+                sum[d] += q[d] * weight;
+            total_weight += weight;
+        }
+    }
+
+    void shift(const float *point, const float *points, int n, float bandwidth, float *out) const {
+        float scale = -0.5f / (bandwidth * bandwidth);
+        /* Sums in double: the shifts are compared with epsilon, well below the float resolution
+           of a sum of hundreds of weighted points. */
+        double sum[D] = {};
+        double total_weight = 0;
+
+        if (!indexed_) {
+            accumulate(point, points, 0, n, NULL, scale, INFINITY, sum, total_weight);
+        }
+        else {
+            float cutoff_sqr = cell_size_ * cell_size_;
+            long long lo[D], hi[D], c[D];
+            for (int d = 0; d < D; d++) {
+                long long cell = cell_of(point, d);
+                lo[d] = std::max(cell - 1, 0LL);
+                hi[d] = std::min(cell + 1, cells_[d] - 1);
+                if (lo[d] > hi[d]) {
+                    std::copy(point, point + D, out);
+                    return;
+                }
+                c[d] = lo[d];
+            }
+            for (;;) {
+                long long key = 0;
+                for (int d = 0; d < D; d++)
+                    key = key * cells_[d] + c[d];
+                std::unordered_map<long long, std::pair<int, int> >::const_iterator cell = ranges_.find(key);
+                if (cell != ranges_.end())
+                    accumulate(point, points, cell->second.first, cell->second.second, &index_[0],
+                               scale, cutoff_sqr, sum, total_weight);
+
+                int d = D - 1;
+                while (d >= 0 && c[d] == hi[d]) {
+                    c[d] = lo[d];
+                    d--;
+                }
+                if (d < 0)
+                    break;
+                c[d]++;
+            }
+        }
+
+        if (total_weight == 0) {
+            std::copy(point, point + D, out);
+            return;
+        }
+        for (int d = 0; d < D; d++)
+            out[d] = sum[d] / total_weight;
+    }
+};
+
+typedef MeanShiftFlat<2> MeanShift2D;
+typedef MeanShiftFlat<3> MeanShift3D;
+typedef MeanShiftFlat<4> MeanShift4D;
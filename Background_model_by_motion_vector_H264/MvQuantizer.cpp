@@ -0,0 +1,79 @@
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "MvQuantizer.h"
+
+MvQuantizer::MvQuantizer(){
+    for (int y = -range; y < range; y++)
+        for (int x = -range; x < range; x++) {
+            direction_[(y + range) * 2 * range + (x + range)] = sector(x, y);
+            magnitude_[(y + range) * 2 * range + (x + range)] = length(x, y);
+        }
+}
+
+int MvQuantizer::sector(int x, int y){
+    if (x == 0 && y == 0) return 0;
+    if (x > 0) {
+        if (y > x) return 2;
+        else if (y > 0) return 1;
+        else if (y > -x) return 8;
+        else return 7;
+    }
+    else {
+        if (y > -x) return 3;
+        else if (y > 0) return 4;
+        else if (y < x) return 6;
+        else return 5;
+    }
+}
+
+int MvQuantizer::length(double x, double y){
+    return (int)round(sqrt(x * x + y * y));
+}
+
+void MvQuantizer::quantize(const double *mv_x, const double *mv_y, int n, uint8_t *direction, uint16_t *magnitude) const{
+    for (int i = 0; i < n; i++) {
+        /* Truncation toward zero, as the int parameters of calculate_angle(). */
+        double fx = mv_x[i], fy = mv_y[i];
+        if (fx > -range - 1 && fx < range && fy > -range - 1 && fy < range) {
+            int x = (int)fx, y = (int)fy;
+            int index = (y + range) * 2 * range + (x + range);
+            direction[i] = direction_[index];
+            magnitude[i] = (x == fx && y == fy) ? magnitude_[index] : length(fx, fy);
+        }
+        else {
+            direction[i] = sector((int)fx, (int)fy);
+            magnitude[i] = length(fx, fy);
+        }
+    }
+}
+
+void MvQuantizer::histogram(const uint8_t *direction, int n, int counts[9]){
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    while (i + 16 <= n) {
+        /* Byte counters hold up to 255 blocks of 16 directions. */
+        int blocks = (n - i) / 16;
+        if (blocks > 255) blocks = 255;
+
+        __m128i bins[9];
+        for (int d = 0; d < 9; d++)
+            bins[d] = zero;
+
+        for (int b = 0; b < blocks; b++, i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(direction + i));
+            for (int d = 0; d < 9; d++)
+                bins[d] = _mm_sub_epi8(bins[d], _mm_cmpeq_epi8(v, _mm_set1_epi8((char)d)));
+        }
+
+        for (int d = 0; d < 9; d++) {
+            __m128i sums = _mm_sad_epu8(bins[d], zero);
+            counts[d] += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+        }
+    }
+#endif
+    for (; i < n; i++)
+        counts[direction[i]]++;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Direction and magnitude of motion vectors through lookup tables.
+ *
+ * Quarter-pel components in [-range, range) index two tables of
+ * (2 * range)^2 bytes: the sector of calculate_angle() (0 without motion,
+ * 1 to 8 otherwise) and the rounded length. Vectors out of the tables, or
+ * with a fractional part for the length, fall back to the exact computation,
+ * so results never depend on the tables.
+ */
+class MvQuantizer {
+public:
+    static const int range = 128;
+
+    MvQuantizer();
+
+    /* Sector of the vector, components truncated to integers as calculate_angle() does. */
+    int direction(int x, int y) const {
+        if (x >= -range && x < range && y >= -range && y < range)
+            return direction_[(y + range) * 2 * range + (x + range)];
+        return sector(x, y);
+    }
+
+    /* Rounded length of an integer vector. */
+    int magnitude(int x, int y) const {
+        if (x >= -range && x < range && y >= -range && y < range)
+            return magnitude_[(y + range) * 2 * range + (x + range)];
+        return length(x, y);
+    }
+
+    /* Reference branch tree for the sectors. */
+    static int sector(int x, int y);
+    static int length(double x, double y);
+
+    /* Direction and rounded length of n vectors. */
+    void quantize(const double *mv_x, const double *mv_y, int n, uint8_t *direction, uint16_t *magnitude) const;
+
+    /* Adds the number of occurrences of each direction 0 to 8 among n to counts, without
+       scattered increments: every direction is compared with every bin, 16 at once. */
+    static void histogram(const uint8_t *direction, int n, int counts[9]);
+
+private:
+    uint8_t direction_[4 * range * range];
+    uint8_t magnitude_[4 * range * range];
+};
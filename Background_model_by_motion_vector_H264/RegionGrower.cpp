@@ -0,0 +1,109 @@
+#include <math.h>
+#include "RegionGrower.h"
+
+using namespace std;
+
+static const int neighbor_x[8] = { 0, 1, 0, -1, -1, 1, 1, -1 };
+static const int neighbor_y[8] = { -1, 0, 1, 0, 1, 1, -1, -1 };
+
+RegionGrower::RegionGrower(int queue_size, int budget, double min_dominance, double length_tolerance)
+    : queue_size_(queue_size), budget_(budget), min_dominance_(min_dominance),
+      length_tolerance_(length_tolerance), queue_(queue_size), head_(0), count_(0),
+      grown_(0), dropped_(0), exhausted_(false) {
+}
+
+/* Annexes the background neighbors of (x, y) matching the criterion of blob. */
+void RegionGrower::expand(int x, int y, int blob, int *image, int height, int width, int stride,
+                          const uint8_t *direction, const uint16_t *magnitude, int feature_stride){
+    const Criterion &c = criteria_[blob];
+    int value = image[y * stride + x];
+
+    for (int i = 0; i < 8; i++) {
+        int xx = x + neighbor_x[i];
+        int yy = y + neighbor_y[i];
+        if (xx < 0 || yy < 0 || xx >= width || yy >= height || image[yy * stride + xx] > 0)
+            continue;
+        int f = yy * feature_stride + xx;
+        if (direction[f] != c.direction || magnitude[f] < c.length_min || magnitude[f] > c.length_max)
+            continue;
+
+        image[yy * stride + xx] = value;
+        grown_++;
+        if (count_ == queue_size_) {
+            dropped_++;
+            continue;
+        }
+        Entry &e = queue_[(head_ + count_) % queue_size_];
+        e.x = xx;
+        e.y = yy;
+        e.blob = blob;
+        count_++;
+    }
+}
+
+int RegionGrower::grow(const ConnectedComponents &ccl, int *image, int height, int width, int stride,
+                       const uint8_t *direction, const uint16_t *magnitude, int feature_stride, int size_min){
+    const vector<Blob> &blobs = ccl.blobs();
+    const vector<ConnectedComponents::Run> &runs = ccl.runs();
+
+    grown_ = 0;
+    dropped_ = 0;
+    exhausted_ = false;
+    head_ = 0;
+    count_ = 0;
+
+    /* Share of the dominant direction in every blob. */
+    dominant_.assign(blobs.size(), 0);
+    for (size_t r = 0; r < runs.size(); r++) {
+        const ConnectedComponents::Run &run = runs[r];
+        int d = blobs[run.label - 1].direction;
+        const uint8_t *row = direction + run.row * feature_stride;
+        for (int x = run.start; x < run.end; x++)
+            dominant_[run.label - 1] += (d != 0 && row[x] == d);
+    }
+
+    criteria_.resize(blobs.size());
+    bool any = false;
+    for (size_t b = 0; b < blobs.size(); b++) {
+        const Blob &blob = blobs[b];
+        Criterion &c = criteria_[b];
+        c.direction = 0;
+        if (blob.area < size_min || blob.direction == 0 || dominant_[b] < min_dominance_ * blob.area)
+            continue;
+        c.direction = blob.direction;
+        c.length_min = (int)ceil(blob.mv_length * (1 - length_tolerance_));
+        c.length_max = (int)floor(blob.mv_length * (1 + length_tolerance_));
+        any = any || (c.length_min <= c.length_max);
+    }
+    if (!any)
+        return 0;
+
+    /* First frontier: the pixels of the growing blobs. */
+    int budget = budget_;
+    for (size_t r = 0; r < runs.size(); r++) {
+        const ConnectedComponents::Run &run = runs[r];
+        int blob = run.label - 1;
+        if (criteria_[blob].direction == 0)
+            continue;
+        for (int x = run.start; x < run.end; x++) {
+            if (budget-- == 0) {
+                exhausted_ = true;
+                return grown_;
+            }
+            expand(x, run.row, blob, image, height, width, stride, direction, magnitude, feature_stride);
+        }
+    }
+
+    /* Then the annexed pixels, in the order they were annexed. */
+    while (count_ > 0) {
+        if (budget-- == 0) {
+            exhausted_ = true;
+            break;
+        }
+        Entry e = queue_[head_];
+        head_ = (head_ + 1) % queue_size_;
+        count_--;
+        expand(e.x, e.y, e.blob, image, height, width, stride, direction, magnitude, feature_stride);
+    }
+    return grown_;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "ConnectedComponents.h"
+
+/*
+ * Motion-coherent growing of the blobs kept by filter(), the refinement that
+ * segmentation() used to do with a second BFS over mark/qx/qy.
+ *
+ * A blob whose motion has a clear dominant direction (its share of the blob
+ * is at least min_dominance) annexes the background pixels around it that
+ * move in the same sector, with a length within length_tolerance of the mean
+ * length of the blob. Directions and lengths are read from the planes filled
+ * once per frame, nothing is recomputed per candidate.
+ *
+ * All blobs grow together, breadth first: their runs are the first frontier,
+ * then the annexed pixels go through a ring buffer of queue_size entries. A
+ * pixel annexed while the buffer is full is kept but not expanded. At most
+ * budget pixels are expanded per frame, so the cost of the stage is bounded
+ * whatever the motion field.
+ */
+class RegionGrower {
+public:
+    RegionGrower(int queue_size = 1 << 16, int budget = 1 << 18,
+                 double min_dominance = 2.8 / 16, double length_tolerance = 0.3);
+
+    /* Grows the blobs of ccl of at least size_min pixels into the pixels <= 0 of image, which
+       is the image labelled by ccl after its filtering. direction and magnitude are on the grid
+       of image, rows feature_stride apart. Annexed pixels take the value of the pixel they are
+       reached from. Returns the number of pixels annexed; ccl still describes the blobs before
+       growth, and grown blobs may have merged, so image must be labelled again when it is not 0. */
+    int grow(const ConnectedComponents &ccl, int *image, int height, int width, int stride,
+             const uint8_t *direction, const uint16_t *magnitude, int feature_stride, int size_min);
+
+    /* Statistics of the last call to grow. */
+    int grown() const { return grown_; }
+    int dropped() const { return dropped_; }  /* Annexed but not expanded, the queue was full. */
+    bool exhausted() const { return exhausted_; }
+
+private:
+    int queue_size_;
+    int budget_;
+    double min_dominance_;
+    double length_tolerance_;
+
+    /* Growth criterion of every blob of ccl. */
+    struct Criterion {
+        int direction;        /* 0 when the blob does not grow. */
+        int length_min, length_max;
+    };
+    std::vector<Criterion> criteria_;
+    std::vector<int> dominant_; /* Pixels of every blob moving in its dominant direction. */
+
+    struct Entry {
+        int x, y;
+        int blob;
+    };
+    std::vector<Entry> queue_;
+    int head_, count_;
+
+    int grown_, dropped_;
+    bool exhausted_;
+
+    void expand(int x, int y, int blob, int *image, int height, int width, int stride,
+                const uint8_t *direction, const uint16_t *magnitude, int feature_stride);
+};
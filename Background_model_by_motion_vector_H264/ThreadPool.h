@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Persistent threads running the iterations of a loop. parallel_for() hands
+ * out the indices one by one, the calling thread takes part in the work, and
+ * it returns once every index has been processed. Calls must not be nested.
+ */
+class ThreadPool {
+public:
+    /* threads counts the calling thread, 0 for one thread per core. */
+    explicit ThreadPool(int threads = 0) : generation_(0), quit_(false), task_(NULL), next_(0), count_(0), pending_(0) {
+        if (threads <= 0)
+            threads = std::thread::hardware_concurrency();
+        for (int i = 1; i < threads; i++)
+            workers_.push_back(std::thread(&ThreadPool::work, this));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        start_.notify_all();
+        for (size_t i = 0; i < workers_.size(); i++)
+            workers_[i].join();
+    }
+
+    int size() const { return workers_.size() + 1; }
+
+    void parallel_for(int count, const std::function<void(int)> &task) {
+        if (count <= 0)
+            return;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        task_ = &task;
+        next_ = 0;
+        count_ = count;
+        pending_ = count;
+        generation_++;
+        start_.notify_all();
+
+        run(lock);
+        while (pending_ > 0)
+            finished_.wait(lock);
+        task_ = NULL;
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_, finished_;
+    unsigned long generation_;
+    bool quit_;
+
+    const std::function<void(int)> *task_;
+    int next_, count_, pending_;
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool & operator=(const ThreadPool &);
+
+    /* Takes indices until none is left, called with the lock held. */
+    void run(std::unique_lock<std::mutex> &lock) {
+        while (next_ < count_) {
+            int index = next_++;
+            const std::function<void(int)> &task = *task_;
+
+            lock.unlock();
+            task(index);
+            lock.lock();
+
+            if (--pending_ == 0)
+                finished_.notify_one();
+        }
+    }
+
+    void work() {
+        unsigned long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            while (generation_ == seen && !quit_)
+                start_.wait(lock);
+            if (quit_)
+                break;
+            seen = generation_;
+            run(lock);
+        }
+    }
+};
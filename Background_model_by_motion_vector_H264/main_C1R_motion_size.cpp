@@ -5,6 +5,7 @@
  */
 #include <iostream>
 #include <fstream>
+#include <cstring>
 #include "opencv2/imgproc.hpp"
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
@@ -12,7 +13,15 @@
 
 
 #include "vibe-background-sequential.h"
+#include "vibe-block-sequential.h"
 #include "MeanShift.h"
+#include "ConnectedComponents.h"
+#include "BlobTracker.h"
+#include "MvQuantizer.h"
+#include "RegionGrower.h"
+#include "DetectionWriter.h"
+#include "BlobSplitter.h"
+#include "JmReader.h"
 
 
 using namespace cv;
@@ -28,7 +37,11 @@ void processVideo(char* videoFilename);
 void read_jm_res(int height, int width);
 void preprocess(uint8_t *image_data, uint8_t *tmp, int height, int width);
 void postprocess(uint8_t *image_data, uint8_t *tmp, int height, int width);
-void filter(int height, int width, int size_min);
+void compute_update_map(uint8_t *update_map, int height, int width);
+void aggregate_macroblocks(const uint16_t *magnitude, const uint8_t *direction, uint16_t *mb_bits,
+                           uint16_t *mb_magnitude, uint8_t *mb_direction, int height, int width);
+int save_model(const vibeModel_Sequential_t *model, const char *filename);
+void filter(int height, int width, int size_min, const BlobFeatures *features);
 void filter_cadidate(int height, int width, int pSize_min);
 int calculate_angle(int x, int y);
 void segmentation(int py, int px, int height, int width, int pSize_min);
@@ -37,8 +50,7 @@ void segmentation(int py, int px, int height, int width, int pSize_min);
 // long coding
 const int max_width = 1000;
 const int max_height = 1000;
-ifstream motion_file;
-ifstream bit_file;
+JmReader jm;                 /* MV and BitSize files of the JM decoder. */
 int bit[max_height][max_width];
 int res[max_height][max_width];
 int type[max_height][max_width];
@@ -56,14 +68,41 @@ int size_min = 320;
 int HWS = 3;
 int maxMV = 0;
 int maxBit = 0;
+bool use_block_model = false; /* Block-grid model on bitsize/MV/direction instead of the alpha/beta fused frame. */
+bool block_model_on_macroblocks = true; /* Block model on the 16x16 macroblock grid, where bitsize is defined, 16 times smaller than on the 4x4 grid. */
+bool use_fixed_point = false; /* 16-bit fixed-point fusion of alpha*bit + beta*mv_length and 16-bit ViBe. */
+const int fusion_frac_bits = 4; /* Fractional bits of the 16-bit fused frame. */
+bool adaptive_update = false; /* Update factor per macroblock, driven by MV length and bitsize. */
+int static_bitsize = 16;     /* Macroblocks without motion and with fewer bits are never updated. */
+int busy_mv_length = 8;      /* Macroblocks moving faster hold moving objects and are updated slowly. */
+char* snapshot_file = NULL; /* Model snapshot used to warm-start and checkpoint ViBe. */
+bool use_union_find = true;  /* Run-length union-find labeling instead of the BFS of filter_cadidate. */
+ConnectedComponents ccl;
+int filter_threads = 0;      /* Threads of the union-find labeling, 0 for one per core and 1 for the sequential scan. */
+ThreadPool *pool = NULL;     /* Threads shared by the stages of the frame pipeline. */
+bool use_tracker = true;     /* Associates the blobs of successive frames into tracks with stable ids. */
+bool verbose = false;        /* Prints the statistics of the stages of every frame. */
+BlobTracker tracker;
+MvQuantizer quantizer;       /* Lookup tables for the direction and length of the motion vectors. */
+vector<Blob> blobs;          /* Blobs kept by filter() in the current frame, union-find labeling only. */
+bool use_region_growing = false; /* Grows the blobs with a dominant motion into neighbors moving alike, union-find labeling only. */
+RegionGrower grower;
+char* detection_file = NULL; /* Binary stream of the blobs of every frame. */
+bool write_masks = true;     /* Adds the run-length encoded mask to every detection record. */
+DetectionWriter detections;
+bool use_blob_splitting = false; /* Splits the large blobs into parts moving apart, union-find labeling only. */
+BlobSplitter splitter;
 void help()
 {
     cout
     << "--------------------------------------------------------------------------" << endl
     << "This program shows how to use ViBe with OpenCV                            " << endl
     << "Usage:"                                                                     << endl
-    << "./main-opencv <video filename>"                                             << endl
+    << "./main-opencv <video filename> <MV file> <BitSize file> [threshold] [snapshot] [detections]" << endl
     << "for example: ./main-opencv video.avi"                                       << endl
+    << "The model is resumed from <snapshot> when it exists and saved there every GOP" << endl
+    << "The blobs of every frame are written to <detections>"                      << endl
+    << "Pass - as <snapshot> to write detections without any snapshot"             << endl
     << "--------------------------------------------------------------------------" << endl
     << endl;
 }
@@ -90,13 +129,14 @@ int main(int argc, char* argv[])
   namedWindow("Bit");
   namedWindow("Motion");
 
-  motion_file.open(argv[2]);
-  bit_file.open(argv[3]);
+  jm.open(argv[2], argv[3]);
+  /* "-" leaves an optional output out, so that detections can be written without a snapshot. */
+  if (argc > 5 && strcmp(argv[5], "-") != 0) snapshot_file = argv[5];
+  if (argc > 6 && strcmp(argv[6], "-") != 0) detection_file = argv[6];
 
   processVideo(argv[1]);
   
-  motion_file.close();
-  bit_file.close();
+  jm.close();
   cout<< "maxBit: " << maxBit <<'\n';
   cout<< "maxMV: " << maxMV <<'\n';
 
@@ -124,23 +164,40 @@ void processVideo(char* videoFilename)
   /* Variables. */
   static int frameNumber = 1; /* The current frame number */
   
-  Mat frame, input_frame;                  /* Current frame. */
+  Mat frame, frame16, input_frame;         /* Current frame, 8-bit and 16-bit fixed-point fusions. */
   Mat segmentationMap,longvt;        /* Will contain the segmentation map. This is the binary output map. */
   Mat bitMap, motionMap, tmp;        /* Will contain the segmentation map. This is the binary output map. */
+  Mat blockBits, blockMotion, blockDirection; /* Feature planes of the block-grid model. */
+  Mat mbBits, mbMotion, mbDirection, mbSegmentation; /* Same planes and segmentation per macroblock. */
+  Mat updateMap;              /* Update factor of every macroblock. */
   int keyboard = 0;           /* Input from keyboard. Used to stop the program. Enter 'q' to quit. */
   
   // long coding
   
   int height, width;
-  bit_file >> width >> height;
-  motion_file >> width >> height;
+  jm.read_size(width, height);
   cout << height << ' ' << width;
 
 
   frame = Mat(height, width, CV_8UC1);
+  frame16 = Mat(height, width, CV_16UC1);
   bitMap = Mat(height, width, CV_8UC1);
   motionMap = Mat(height, width, CV_8UC1);
   tmp = Mat(height, width, CV_8UC1);
+  blockBits = Mat(height, width, CV_16UC1);
+  blockMotion = Mat(height, width, CV_16UC1);
+  blockDirection = Mat(height, width, CV_8UC1);
+  updateMap = Mat(height/4, width/4, CV_8UC1);
+  mbBits = Mat(height/4, width/4, CV_16UC1);
+  mbMotion = Mat(height/4, width/4, CV_16UC1);
+  mbDirection = Mat(height/4, width/4, CV_8UC1);
+  mbSegmentation = Mat(height/4, width/4, CV_8UC1);
+  vibeBlockFeatures_t features = { (uint16_t*)blockBits.data, (uint16_t*)blockMotion.data, blockDirection.data };
+  vibeBlockFeatures_t mbFeatures = { (uint16_t*)mbBits.data, (uint16_t*)mbMotion.data, mbDirection.data };
+  BlobFeatures blobFeatures = { &mv_x[0][0], &mv_y[0][0], max_width, blockDirection.data, (uint16_t*)blockBits.data, width };
+
+  if (detection_file != NULL && !detections.open(detection_file, width, height))
+    cerr << "Unable to open detection file: " << detection_file << endl;
 
   moveWindow("Segmentation",width,height*0.5);
   moveWindow("Bit",width,height*2);
@@ -153,6 +210,11 @@ void processVideo(char* videoFilename)
     cout<<element;
   /* Model for ViBe. */
   vibeModel_Sequential_t *model = NULL; /* Model used by ViBe. */
+  vibeModel_Block_t *blockModel = NULL; /* Model used on the block grid. */
+
+  /* Weights of the 16-bit fusion, in Q8. */
+  long long alpha_q8 = llround(alpha * 256);
+  long long beta_q8 = llround(beta * 256);
 
   /* Read input data. ESC or 'q' for quitting. */
   while ((char)keyboard != 'q' && (char)keyboard != 27) {
@@ -169,6 +231,9 @@ void processVideo(char* videoFilename)
   
     read_jm_res(height/4, width/4);
 
+    for (int i=0;i<height;i++)
+      quantizer.quantize(mv_x[i], mv_y[i], width, blockDirection.data + i*width, (uint16_t*)blockMotion.data + i*width);
+
     for (int i=0;i<height;i++)
       for (int j=0;j<width;j++){
         int index = i*width+j;
@@ -177,12 +242,26 @@ void processVideo(char* videoFilename)
         frame.data[index] = (int)alpha * bitMap.data[index];
         //if (bit[i/4][j/4]>maxBit) maxBit = bit[i/4][j/4];
 
-        motionMap.data[index] = (int)round(sqrt(mv_x[i][j]*mv_x[i][j]+mv_y[i][j]*mv_y[i][j]));
+        motionMap.data[index] = ((uint16_t*)blockMotion.data)[index];
         frame.data[index]+=(int)beta * motionMap.data[index];
+
+        if (use_fixed_point) {
+          /* Same features as the 8-bit frame, with fusion_frac_bits fractional bits and saturation instead of wrapping. */
+          long long bit_q = (long long)bit[i/4][j/4] << (fusion_frac_bits - 2);
+          long long length_q = llround(sqrt(mv_x[i][j]*mv_x[i][j]+mv_y[i][j]*mv_y[i][j]) * (1 << fusion_frac_bits));
+          long long fused = (alpha_q8 * bit_q + beta_q8 * length_q + 128) >> 8;
+          ((uint16_t*)frame16.data)[index] = (uint16_t)std::max(0LL, std::min(fused, 65535LL));
+        }
+
+        ((uint16_t*)blockBits.data)[index] = bit[i/4][j/4];
         //if ((int)round(sqrt(mv_x[i][j]*mv_x[i][j]+mv_y[i][j]*mv_y[i][j]))>maxMV) maxMV = (int)round(sqrt(mv_x[i][j]*mv_x[i][j]+mv_y[i][j]*mv_y[i][j]));
 
     }
 
+    if (use_block_model && block_model_on_macroblocks)
+      aggregate_macroblocks((uint16_t*)blockMotion.data, blockDirection.data, (uint16_t*)mbBits.data,
+                            (uint16_t*)mbMotion.data, mbDirection.data, height, width);
+
     //preprocess(frame.data, tmp.data, height, width);
     //medianBlur(frame, frame, 5); /* 3x3 median filtering */
 
@@ -190,13 +269,63 @@ void processVideo(char* videoFilename)
     if (frameNumber == 1) {
       segmentationMap = Mat(frame.rows, frame.cols, CV_8UC1);
       longvt = Mat(frame.rows, frame.cols, CV_8UC1);
-      model = (vibeModel_Sequential_t*)libvibeModel_Sequential_New();
-      libvibeModel_Sequential_AllocInit_8u_C1R(model, frame.data, frame.cols, frame.rows);
+      if (use_block_model) {
+        blockModel = libvibeModel_Block_New();
+        if (block_model_on_macroblocks)
+          libvibeModel_Block_AllocInit(blockModel, &mbFeatures, width/4, height/4);
+        else
+          libvibeModel_Block_AllocInit(blockModel, &features, width, height);
+        libvibeModel_Block_PrintParameters(blockModel);
+      }
+      else if (use_fixed_point) {
+        model = (vibeModel_Sequential_t*)libvibeModel_Sequential_New();
+        libvibeModel_Sequential_SetMatchingThreshold(model, libvibeModel_Sequential_GetMatchingThreshold(model) << fusion_frac_bits);
+        if (snapshot_file != NULL && libvibeModel_Sequential_Load_16u_C1R(model, snapshot_file, frame16.cols, frame16.rows) == 0)
+          cout << "Resuming ViBe model from " << snapshot_file << endl;
+        else
+          libvibeModel_Sequential_AllocInit_16u_C1R(model, (uint16_t*)frame16.data, frame16.cols, frame16.rows);
+      }
+      else {
+        model = (vibeModel_Sequential_t*)libvibeModel_Sequential_New();
+        if (snapshot_file != NULL && libvibeModel_Sequential_Load_8u_C1R(model, snapshot_file, frame.cols, frame.rows) == 0)
+          cout << "Resuming ViBe model from " << snapshot_file << endl;
+        else
+          libvibeModel_Sequential_AllocInit_8u_C1R(model, frame.data, frame.cols, frame.rows);
+      }
     }  
 
     /* ViBe: Segmentation and updating. */
-    libvibeModel_Sequential_Segmentation_8u_C1R(model, frame.data, segmentationMap.data, longvt.data);
-    libvibeModel_Sequential_Update_8u_C1R(model, frame.data, segmentationMap.data);
+    if (use_block_model) {
+      if (block_model_on_macroblocks) {
+        libvibeModel_Block_Segmentation(blockModel, &mbFeatures, mbSegmentation.data);
+        libvibeModel_Block_Update(blockModel, &mbFeatures, mbSegmentation.data);
+        /* Back to the 4x4 grid of the rest of the pipeline, the last partial macroblocks take the label of the last whole one. */
+        for (int i=0;i<height;i++)
+          for (int j=0;j<width;j++)
+            segmentationMap.data[i*width+j] = mbSegmentation.data[std::min(i/4, height/4-1)*(width/4) + std::min(j/4, width/4-1)];
+      }
+      else {
+        libvibeModel_Block_Segmentation(blockModel, &features, segmentationMap.data);
+        libvibeModel_Block_Update(blockModel, &features, segmentationMap.data);
+      }
+    }
+    else {
+      if (use_fixed_point)
+        libvibeModel_Sequential_Segmentation_16u_C1R(model, (uint16_t*)frame16.data, segmentationMap.data);
+      else
+        libvibeModel_Sequential_Segmentation_8u_C1R(model, frame.data, segmentationMap.data, longvt.data);
+      if (adaptive_update) {
+        compute_update_map(updateMap.data, height, width);
+        if (use_fixed_point)
+          libvibeModel_Sequential_SetUpdateMap_16u_C1R(model, updateMap.data, 4);
+        else
+          libvibeModel_Sequential_SetUpdateMap_8u_C1R(model, updateMap.data, 4);
+      }
+      if (use_fixed_point)
+        libvibeModel_Sequential_Update_16u_C1R(model, (uint16_t*)frame16.data, segmentationMap.data);
+      else
+        libvibeModel_Sequential_Update_8u_C1R(model, frame.data, segmentationMap.data);
+    }
 
     
     
@@ -206,7 +335,25 @@ void processVideo(char* videoFilename)
         res[i][j] = segmentationMap.data[index];
       }
     }  
-    filter(height,width, size_min);
+    filter(height,width, size_min, &blobFeatures);
+    /* The blobs are labelled again on the grown mask, so that the runs, descriptors and blobs used
+       by the splitter, the tracker and the detection records match it. */
+    if (use_region_growing && use_union_find &&
+        grower.grow(ccl, &res[0][0], height, width, max_width, blockDirection.data, (uint16_t*)blockMotion.data, width, size_min) > 0)
+      filter(height,width, size_min, &blobFeatures);
+    if (use_blob_splitting && use_union_find) {
+      if (pool == NULL) pool = new ThreadPool(filter_threads);
+      splitter.split(pool, ccl, blobFeatures, blobs);
+    }
+    if (use_tracker && use_union_find) {
+      tracker.update(blobs);
+      if (verbose)
+        cout << "tracks " << tracker.tracks().size() << "\n";
+    }
+    if (detections.is_open() && use_union_find &&
+        !detections.write(frameNumber, blobs, use_tracker ? &tracker.blob_ids() : NULL,
+                          write_masks ? &res[0][0] : NULL, max_width))
+      cerr << "Unable to write detections of frame " << frameNumber << endl;
     for (int i=0;i<height;i++){
       for (int j=0;j<width;j++){
         int index = i*width+j;
@@ -240,6 +387,10 @@ void processVideo(char* videoFilename)
    // resize(segmentationMap, segmentationMap, cv::Size(), 0.5, 0.5);
     resize(input_frame, input_frame, cv::Size(), 4, 4);
 
+    /* Checkpoint the model so that a restart resumes from a converged background. */
+    if (snapshot_file != NULL && model != NULL && frameNumber % GOP == 0)
+      save_model(model, snapshot_file);
+
     ++frameNumber;
 
     /* Gets the input from the keyboard. */
@@ -249,8 +400,15 @@ void processVideo(char* videoFilename)
   /* Delete capture object. */
   capture.release();
 
-  /* Frees the model. */
+  /* Saves and frees the model. */
+  if (snapshot_file != NULL && model != NULL && save_model(model, snapshot_file) != 0)
+    cerr << "Unable to save model snapshot: " << snapshot_file << endl;
   libvibeModel_Sequential_Free(model);
+  libvibeModel_Block_Free(blockModel);
+  delete pool;
+  pool = NULL;
+  if (!detections.close())
+    cerr << "Unable to write detection file: " << detection_file << endl;
 }
 
 // long coding
@@ -260,18 +418,59 @@ int dir_x[8] = { 0 ,1,0,-1,-1, 1, 1, -1};
 int dir_y[8] = { -1,0,1, 0, 1, 1,-1, -1};
 
 void read_jm_res(int height, int width){
-  int x;
-  motion_file >> x;
-  bit_file >> x;
-  for (int i=0;i<height;i++)
-    for (int j=0;j<width;j++){
-      bit_file >> bit[i][j] >> type[i][j];
+  jm.read_frame(height, width, &bit[0][0], &type[0][0], max_width, &mv_x[0][0], &mv_y[0][0], max_width);
+}
+
+/*
+ * Features of every macroblock for the block model on the macroblock grid:
+ * its bitsize, the mean length of its 16 motion vectors (as compute_update_map
+ * does) and the most frequent direction among the moving ones, 0 when none
+ * moves. height and width are those of the 4x4 grid.
+ */
+void aggregate_macroblocks(const uint16_t *magnitude, const uint8_t *direction, uint16_t *mb_bits,
+                           uint16_t *mb_magnitude, uint8_t *mb_direction, int height, int width){
+  for (int i=0;i<height/4;i++)
+    for (int j=0;j<width/4;j++){
+      int length = 0;
+      int counts[9] = { 0 };
+      for (int u = 0; u<4; u++)
+        for (int v = 0; v<4; v++){
+          int index = (i*4+u)*width + j*4+v;
+          length += magnitude[index];
+          counts[direction[index]]++;
+        }
+
+      int dominant = 0;
+      for (int d = 1; d < 9; d++)
+        if (counts[d] > 0 && (dominant == 0 || counts[d] > counts[dominant])) dominant = d;
+
+      int index = i*(width/4)+j;
+      mb_bits[index] = bit[i][j];
+      mb_magnitude[index] = (length + 8) / 16;
+      mb_direction[index] = dominant;
     }
-  for (int i=0;i<height*4;i++)
-    for (int j=0;j<width*4;j++){
-      motion_file >> mv_x[i][j] >> mv_y[i][j];
-      //mv_x[i][j]/=8;
-      //mv_y[i][j]/=8;
+}
+
+/*
+ * Update factor of every macroblock for the ViBe model working on the 4x4 grid.
+ * Static macroblocks coded with a few bits are a converged background and are
+ * frozen, fast moving ones hold objects that must not be absorbed, and
+ * macroblocks whose bits change without motion (light, noise) adapt quickly.
+ */
+void compute_update_map(uint8_t *update_map, int height, int width){
+  for (int i=0;i<height/4;i++)
+    for (int j=0;j<width/4;j++){
+      double length = 0;
+      for (int u = 0; u<4; u++)
+        for (int v = 0; v<4; v++)
+          length += sqrt(mv_x[i*4+u][j*4+v]*mv_x[i*4+u][j*4+v]+mv_y[i*4+u][j*4+v]*mv_y[i*4+u][j*4+v]);
+      length /= 16;
+
+      uint8_t factor = 16;
+      if (length == 0 && bit[i][j] <= static_bitsize) factor = 0;
+      else if (length >= busy_mv_length) factor = 64;
+      else if (length == 0) factor = 4;
+      update_map[i*(width/4)+j] = factor;
     }
 }
 
@@ -335,8 +534,30 @@ void postprocess(uint8_t *image_data, uint8_t *tmp, int height, int width){
 }
 
 
-void filter(int height, int width, int size) {
-  filter_cadidate(height, width, size);
+int save_model(const vibeModel_Sequential_t *model, const char *filename) {
+  /* A fixed-point model only holds 16-bit samples. */
+  if (use_fixed_point)
+    return libvibeModel_Sequential_Save_16u_C1R(model, filename);
+  return libvibeModel_Sequential_Save_8u_C1R(model, filename);
+}
+
+
+void filter(int height, int width, int size, const BlobFeatures *features) {
+  blobs.clear();
+  if (use_union_find) {
+    /* Same size filtering as filter_cadidate, which is kept as the reference. */
+    if (filter_threads != 1) {
+      if (pool == NULL) pool = new ThreadPool(filter_threads);
+      ccl.label(*pool, &res[0][0], height, width, max_width, features);
+    }
+    else
+      ccl.label(&res[0][0], height, width, max_width, features);
+    ccl.filter_size(&res[0][0], max_width, size);
+    for (size_t i = 0; i < ccl.blobs().size(); i++)
+      if (ccl.blobs()[i].area >= size) blobs.push_back(ccl.blobs()[i]);
+  }
+  else
+    filter_cadidate(height, width, size);
 }
 
 
@@ -481,18 +702,5 @@ void segmentation(int py, int px, int height, int width, int pSize_min) {
 }
 
 int calculate_angle(int x, int y) {
-  if (x == 0 && y == 0) return 0;
-  if (x > 0) {
-    if (y > x) return 2;
-    else if (y > 0) return 1;
-    else if (y > -x) return 8;
-    else return 7;
-  }
-  else {
-    if (y > -x) return 3;
-    else if (y > 0) return 4;
-    else if (y < x) return 6;
-    else return 5;
-  }
-  return 0;
+  return quantizer.direction(x, y);
 }
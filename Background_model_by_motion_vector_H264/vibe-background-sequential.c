@@ -1,10 +1,55 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "vibe-background-sequential.h"
 
 #define NUMBER_OF_HISTORY_IMAGES 25
 
+/* Per-block update rates are rounded to a power of two, 2^0 to 2^(NUMBER_OF_UPDATE_CLASSES - 1). */
+#define NUMBER_OF_UPDATE_CLASSES 8
+#define UPDATE_CLASS_FROZEN      0xFF
+
+/* Snapshot file identification. The magic reads "VIBE" in a little-endian dump. */
+#define VIBE_SNAPSHOT_MAGIC   0x45424956u
+#define VIBE_SNAPSHOT_VERSION 1u
+#define VIBE_SNAPSHOT_8U_C1R  1u
+#define VIBE_SNAPSHOT_16U_C1R 2u
+
+/*
+ * On-disk header of a model snapshot. It is followed by the jump, neighbor and
+ * position buffers (randomBufferSize 32-bit values each) and then by the
+ * NUMBER_OF_HISTORY_IMAGES history planes, of 8 or 16-bit samples depending on
+ * the format. Values are stored in host byte order.
+ */
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t headerSize;
+  uint32_t numberOfHistoryImages;
+  uint32_t width;
+  uint32_t height;
+  uint32_t numberOfSamples;
+  uint32_t matchingThreshold;
+  uint32_t matchingNumber;
+  uint32_t updateFactor;
+  uint32_t lastHistoryImageSwapped;
+  uint32_t randomBufferSize;
+  uint32_t reserved;
+  uint64_t fileSize;
+} vibeSnapshotHeader_t;
+
 
 struct vibeModel_Sequential
 {
@@ -20,10 +65,20 @@ struct vibeModel_Sequential
   uint8_t *historyImage;
   uint32_t lastHistoryImageSwapped;
 
+  /* Storage for the history of 16-bit models, with the sum of the samples of every pixel. */
+  uint16_t *historyImage16;
+  uint32_t *historySum;
+
   /* Buffers with random values. */
   uint32_t *jump;
   int *neighbor;
   uint32_t *position;
+
+  /* Optional per-block update rates: one class per block and one jump buffer per class. */
+  uint8_t *updateClass;
+  uint32_t *jumpClass;
+  uint32_t updateBlockSize;
+  uint32_t updateBlocksPerRow;
 };
 
 // -----------------------------------------------------------------------------
@@ -65,12 +120,20 @@ vibeModel_Sequential_t *libvibeModel_Sequential_New()
   /* Storage for the history. */
   model->historyImage            = NULL;
   model->lastHistoryImageSwapped = 0;
+  model->historyImage16          = NULL;
+  model->historySum              = NULL;
 
   /* Buffers with random values. */
   model->jump                    = NULL;
   model->neighbor                = NULL;
   model->position                = NULL;
 
+  /* No per-block update rates until libvibeModel_Sequential_SetUpdateMap_8u_C1R is called. */
+  model->updateClass             = NULL;
+  model->jumpClass               = NULL;
+  model->updateBlockSize         = 0;
+  model->updateBlocksPerRow      = 0;
+
   return(model);
 }
 
@@ -157,14 +220,42 @@ int32_t libvibeModel_Sequential_Free(vibeModel_Sequential_t *model)
 
 
   free(model->historyImage);
+  free(model->historyImage16);
+  free(model->historySum);
   free(model->jump);
   free(model->neighbor);
   free(model->position);
+  free(model->updateClass);
+  free(model->jumpClass);
   free(model);
 
   return(0);
 }
 
+// -----------------------------------------------------------------------------
+// Allocates and fills the buffers with random values
+// -----------------------------------------------------------------------------
+static void alloc_random_buffers(vibeModel_Sequential_t *model)
+{
+  uint32_t width = model->width;
+  int size = (model->width > model->height) ? 2 * model->width + 1 : 2 * model->height + 1;
+
+  model->jump = (uint32_t*)malloc(size * sizeof(*(model->jump)));
+  assert(model->jump != NULL);
+
+  model->neighbor = (int*)malloc(size * sizeof(*(model->neighbor)));
+  assert(model->neighbor != NULL);
+
+  model->position = (uint32_t*)malloc(size * sizeof(*(model->position)));
+  assert(model->position != NULL);
+
+  for (int i = 0; i < size; ++i) {
+    model->jump[i] = (rand() % (2 * model->updateFactor)) + 1;            // Values between 1 and 2 * updateFactor.
+    model->neighbor[i] = ((rand() % 3) - 1) + ((rand() % 3) - 1) * width; // Values between { -width - 1, ... , width + 1 }.
+    model->position[i] = rand() % (model->numberOfSamples);               // Values between 0 and numberOfSamples - 1.
+  }
+}
+
 // -----------------------------------------------------------------------------
 // Allocates and initializes a C1R model structure
 // -----------------------------------------------------------------------------
@@ -194,7 +285,224 @@ int32_t libvibeModel_Sequential_AllocInit_8u_C1R(
   }
 
   /* Fills the buffers with random values. */
-  int size = (width > height) ? 2 * width + 1 : 2 * height + 1;
+  alloc_random_buffers(model);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Per-block update rates of a C1R model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_SetUpdateMap_8u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *update_map,
+  const uint32_t blockSize
+) {
+  /* Basic checks. */
+  assert(model != NULL);
+  assert((model->width > 0) && (model->height > 0) && (model->jump != NULL));
+
+  /* NULL switches back to the global update factor. */
+  if (update_map == NULL) {
+    free(model->updateClass);
+    model->updateClass = NULL;
+    model->updateBlockSize = 0;
+    model->updateBlocksPerRow = 0;
+    return(0);
+  }
+
+  assert(blockSize > 0);
+
+  uint32_t blocksPerRow = (model->width + blockSize - 1) / blockSize;
+  uint32_t blocksPerColumn = (model->height + blockSize - 1) / blockSize;
+  int size = (model->width > model->height) ? 2 * model->width + 1 : 2 * model->height + 1;
+
+  /* The jump buffers of the classes only depend on the model size, they are drawn once. */
+  if (model->jumpClass == NULL) {
+    model->jumpClass = (uint32_t*)malloc(NUMBER_OF_UPDATE_CLASSES * size * sizeof(*(model->jumpClass)));
+    assert(model->jumpClass != NULL);
+
+    for (int c = 0; c < NUMBER_OF_UPDATE_CLASSES; ++c) {
+      uint32_t factor = 1u << c;
+
+      for (int i = 0; i < size; ++i)
+        model->jumpClass[c * size + i] = (factor == 1) ? 1 : (rand() % (2 * factor)) + 1; // 1 or values between 1 and 2 * factor.
+    }
+  }
+
+  if ((model->updateClass == NULL) || (model->updateBlockSize != blockSize)) {
+    free(model->updateClass);
+    model->updateClass = (uint8_t*)malloc(blocksPerRow * blocksPerColumn * sizeof(*(model->updateClass)));
+    assert(model->updateClass != NULL);
+  }
+
+  model->updateBlockSize = blockSize;
+  model->updateBlocksPerRow = blocksPerRow;
+
+  /* Rounds every factor down to a power of two, 0 freezes the block. */
+  for (uint32_t i = 0; i < blocksPerRow * blocksPerColumn; ++i) {
+    uint8_t factor = update_map[i];
+    uint8_t c = 0;
+
+    if (factor == 0) {
+      model->updateClass[i] = UPDATE_CLASS_FROZEN;
+      continue;
+    }
+
+    while ((c < NUMBER_OF_UPDATE_CLASSES - 1) && ((2u << c) <= factor))
+      ++c;
+    model->updateClass[i] = c;
+  }
+
+  return(0);
+}
+
+static inline int update_is_frozen(const vibeModel_Sequential_t *model, const uint32_t x, const uint32_t y)
+{
+  if (model->updateClass == NULL)
+    return(0);
+
+  uint32_t block = (x / model->updateBlockSize) + (y / model->updateBlockSize) * model->updateBlocksPerRow;
+  return(model->updateClass[block] == UPDATE_CLASS_FROZEN);
+}
+
+// -----------------------------------------------------------------------------
+// Writes the header, the random buffers and the history planes of a model
+// -----------------------------------------------------------------------------
+static int32_t save_snapshot(
+  const vibeModel_Sequential_t *model,
+  const char *filename,
+  uint32_t format,
+  const void *history,
+  size_t historyBytes
+) {
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  uint32_t size = (width > height) ? 2 * width + 1 : 2 * height + 1;
+
+  vibeSnapshotHeader_t header;
+  memset(&header, 0, sizeof(header));
+  header.magic                   = VIBE_SNAPSHOT_MAGIC;
+  header.version                 = VIBE_SNAPSHOT_VERSION;
+  header.format                  = format;
+  header.headerSize              = sizeof(header);
+  header.numberOfHistoryImages   = NUMBER_OF_HISTORY_IMAGES;
+  header.width                   = width;
+  header.height                  = height;
+  header.numberOfSamples         = model->numberOfSamples;
+  header.matchingThreshold       = model->matchingThreshold;
+  header.matchingNumber          = model->matchingNumber;
+  header.updateFactor            = model->updateFactor;
+  header.lastHistoryImageSwapped = model->lastHistoryImageSwapped;
+  header.randomBufferSize        = size;
+  header.fileSize                = sizeof(header) + 3 * (uint64_t)size * sizeof(uint32_t) + historyBytes;
+
+  /* Write to a temporary file first so that a crash never leaves a truncated snapshot behind. */
+  size_t length = strlen(filename);
+  char *tmpname = (char*)malloc(length + 5);
+  assert(tmpname != NULL);
+  memcpy(tmpname, filename, length);
+  memcpy(tmpname + length, ".tmp", 5);
+
+  FILE *file = fopen(tmpname, "wb");
+  if (file == NULL) {
+    free(tmpname);
+    return(-1);
+  }
+
+  int ok = (fwrite(&header, sizeof(header), 1, file) == 1)
+    && (fwrite(model->jump, sizeof(uint32_t), size, file) == size)
+    && (fwrite(model->neighbor, sizeof(int32_t), size, file) == size)
+    && (fwrite(model->position, sizeof(uint32_t), size, file) == size)
+    && (fwrite(history, 1, historyBytes, file) == historyBytes);
+
+  ok = (fclose(file) == 0) && ok;
+  ok = ok && (rename(tmpname, filename) == 0);
+
+  if (!ok)
+    remove(tmpname);
+  free(tmpname);
+
+  return(ok ? 0 : -1);
+}
+
+// -----------------------------------------------------------------------------
+// Maps a snapshot file and checks it holds a model of the given format and
+// size. On success, the parameters and random buffers are restored into the
+// model, whose history is freed, *history points to the history planes and
+// the mapping is returned; the caller copies the planes and unmaps the file.
+// -----------------------------------------------------------------------------
+static const uint8_t *load_snapshot(
+  vibeModel_Sequential_t *model,
+  const char *filename,
+  uint32_t format,
+  const uint32_t width,
+  const uint32_t height,
+  size_t historyBytes,
+  const uint8_t **history,
+  size_t *fileSize
+) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return(NULL);
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(vibeSnapshotHeader_t))) {
+    close(fd);
+    return(NULL);
+  }
+
+  *fileSize = (size_t)st.st_size;
+  const uint8_t *mapped = (const uint8_t*)mmap(NULL, *fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (mapped == (const uint8_t*)MAP_FAILED)
+    return(NULL);
+
+  /* Validates the header against the stream and this build. */
+  vibeSnapshotHeader_t header;
+  memcpy(&header, mapped, sizeof(header));
+
+  uint32_t size = (width > height) ? 2 * width + 1 : 2 * height + 1;
+  size_t tablesSize = 3 * (size_t)size * sizeof(uint32_t);
+
+  if (
+    (header.magic != VIBE_SNAPSHOT_MAGIC) || (header.version != VIBE_SNAPSHOT_VERSION) ||
+    (header.format != format) || (header.headerSize != sizeof(header)) ||
+    (header.numberOfHistoryImages != NUMBER_OF_HISTORY_IMAGES) ||
+    (header.width != width) || (header.height != height) || (header.randomBufferSize != size) ||
+    (header.numberOfSamples == 0) || (header.matchingNumber == 0) || (header.updateFactor == 0) ||
+    (header.fileSize != *fileSize) || (*fileSize != sizeof(header) + tablesSize + historyBytes)
+  ) {
+    munmap((void*)mapped, *fileSize);
+    return(NULL);
+  }
+
+  /* Replaces whatever the model held before. */
+  free(model->historyImage);
+  free(model->historyImage16);
+  free(model->historySum);
+  free(model->jump);
+  free(model->neighbor);
+  free(model->position);
+  free(model->updateClass);
+  free(model->jumpClass);
+
+  model->historyImage            = NULL;
+  model->historyImage16          = NULL;
+  model->historySum              = NULL;
+  model->updateClass             = NULL;
+  model->jumpClass               = NULL;
+  model->updateBlockSize         = 0;
+  model->updateBlocksPerRow      = 0;
+
+  model->width                   = width;
+  model->height                  = height;
+  model->numberOfSamples         = header.numberOfSamples;
+  model->matchingThreshold       = header.matchingThreshold;
+  model->matchingNumber          = header.matchingNumber;
+  model->updateFactor            = header.updateFactor;
+  model->lastHistoryImageSwapped = header.lastHistoryImageSwapped;
 
   model->jump = (uint32_t*)malloc(size * sizeof(*(model->jump)));
   assert(model->jump != NULL);
@@ -205,11 +513,58 @@ int32_t libvibeModel_Sequential_AllocInit_8u_C1R(
   model->position = (uint32_t*)malloc(size * sizeof(*(model->position)));
   assert(model->position != NULL);
 
-  for (int i = 0; i < size; ++i) {
-    model->jump[i] = (rand() % (2 * model->updateFactor)) + 1;            // Values between 1 and 2 * updateFactor.
-    model->neighbor[i] = ((rand() % 3) - 1) + ((rand() % 3) - 1) * width; // Values between { -width - 1, ... , width + 1 }.
-    model->position[i] = rand() % (model->numberOfSamples);               // Values between 0 and numberOfSamples - 1.
-  }
+  const uint8_t *payload = mapped + sizeof(header);
+  memcpy(model->jump, payload, size * sizeof(uint32_t));
+  payload += size * sizeof(uint32_t);
+  memcpy(model->neighbor, payload, size * sizeof(int32_t));
+  payload += size * sizeof(int32_t);
+  memcpy(model->position, payload, size * sizeof(uint32_t));
+  payload += size * sizeof(uint32_t);
+  *history = payload;
+
+  return(mapped);
+}
+
+// -----------------------------------------------------------------------------
+// Saves a C1R model to a snapshot file
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Save_8u_C1R(
+  const vibeModel_Sequential_t *model,
+  const char *filename
+) {
+  /* Basic checks. */
+  assert((model != NULL) && (filename != NULL));
+  assert((model->historyImage != NULL) && (model->jump != NULL));
+
+  size_t historySize = (size_t)NUMBER_OF_HISTORY_IMAGES * model->width * model->height;
+  return(save_snapshot(model, filename, VIBE_SNAPSHOT_8U_C1R, model->historyImage, historySize));
+}
+
+// -----------------------------------------------------------------------------
+// Loads a C1R model from a snapshot file
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Load_8u_C1R(
+  vibeModel_Sequential_t *model,
+  const char *filename,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Basic checks. */
+  assert((model != NULL) && (filename != NULL));
+  assert((width > 0) && (height > 0));
+
+  size_t historySize = (size_t)NUMBER_OF_HISTORY_IMAGES * width * height;
+  const uint8_t *history = NULL;
+  size_t fileSize = 0;
+  const uint8_t *mapped = load_snapshot(model, filename, VIBE_SNAPSHOT_8U_C1R, width, height, historySize, &history, &fileSize);
+  if (mapped == NULL)
+    return(-1);
+
+  model->historyImage = (uint8_t*)malloc(historySize * sizeof(*(model->historyImage)));
+  assert(model->historyImage != NULL);
+  memcpy(model->historyImage, history, historySize);
+
+  munmap((void*)mapped, fileSize);
 
   return(0);
 }
@@ -300,7 +655,7 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
   uint32_t shift, indX, indY;
   int x, y;
 
-  for (y = 1; y < height - 1; ++y) {
+  for (y = 1; y < height - 1 && model->updateClass == NULL; ++y) {
     shift = rand() % width;
     indX = jump[shift]; // index_jump should never be zero (> 1).
 
@@ -322,6 +677,55 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
     }
   }
 
+  /* Same with per-block update rates: frozen blocks are skipped without any test and
+     each block hops with the jump buffer of its class. The walk carries over to the
+     next block when it has the same class. */
+  for (y = 1; y < height - 1 && model->updateClass != NULL; ++y) {
+    const uint8_t *rowClass = model->updateClass + (y / model->updateBlockSize) * model->updateBlocksPerRow;
+    int size = (width > height) ? 2 * width + 1 : 2 * height + 1;
+    uint8_t previousClass = UPDATE_CLASS_FROZEN;
+
+    shift = rand() % width;
+    indX = 0;
+
+    for (uint32_t block = 0; block < model->updateBlocksPerRow; ++block) {
+      uint32_t begin = block * model->updateBlockSize;
+      uint32_t end = begin + model->updateBlockSize;
+      uint8_t c = rowClass[block];
+
+      if (begin < 1) begin = 1;
+      if (end > width - 1) end = width - 1;
+
+      if (c == UPDATE_CLASS_FROZEN) {
+        previousClass = c;
+        continue;
+      }
+
+      const uint32_t *jumpOfClass = model->jumpClass + c * size;
+
+      /* A new walk starts uniformly within one mean jump, so the rate holds on short blocks. */
+      if ((c != previousClass) || (indX < begin))
+        indX = begin + (jumpOfClass[shift] >> 1);
+
+      while (indX < end) {
+        int index = indX + y * width;
+
+        if (updating_mask[index] == COLOR_BACKGROUND) {
+          uint8_t value = image_data[index];
+          int index_neighbor = index + neighbor[shift];
+
+          if (position[shift] < NUMBER_OF_HISTORY_IMAGES) {
+            historyImage[index + position[shift] * width * height] = value;
+            historyImage[index_neighbor + position[shift] * width * height] = value;
+          }
+        }
+        ++shift;
+        indX += jumpOfClass[shift];
+      }
+      previousClass = c;
+    }
+  }
+
   /* First row. */
   y = 0;
   shift = rand() % width;
@@ -330,7 +734,7 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
   while (indX <= width - 1) {
     int index = indX + y * width;
 
-    if (updating_mask[index] == COLOR_BACKGROUND) {
+    if (updating_mask[index] == COLOR_BACKGROUND && !update_is_frozen(model, indX, y)) {
       if (position[shift] < NUMBER_OF_HISTORY_IMAGES)
         historyImage[index + position[shift] * width * height] = image_data[index];
     }
@@ -346,7 +750,7 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
   while (indX <= width - 1) {
     int index = indX + y * width;
 
-    if (updating_mask[index] == COLOR_BACKGROUND) {
+    if (updating_mask[index] == COLOR_BACKGROUND && !update_is_frozen(model, indX, y)) {
       if (position[shift] < NUMBER_OF_HISTORY_IMAGES)
         historyImage[index + position[shift] * width * height] = image_data[index];
      
@@ -364,7 +768,7 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
   while (indY <= height - 1) {
     int index = x + indY * width;
 
-    if (updating_mask[index] == COLOR_BACKGROUND) {
+    if (updating_mask[index] == COLOR_BACKGROUND && !update_is_frozen(model, x, indY)) {
       if (position[shift] < NUMBER_OF_HISTORY_IMAGES)
         historyImage[index + position[shift] * width * height] = image_data[index];
      
@@ -382,7 +786,7 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
   while (indY <= height - 1) {
     int index = x + indY * width;
 
-    if (updating_mask[index] == COLOR_BACKGROUND) {
+    if (updating_mask[index] == COLOR_BACKGROUND && !update_is_frozen(model, x, indY)) {
       if (position[shift] < NUMBER_OF_HISTORY_IMAGES )
         historyImage[index + position[shift] * width * height] = image_data[index];
     }
@@ -392,7 +796,7 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
 
   /* The first pixel! */
   if (rand() % model->updateFactor == 0) {
-    if (updating_mask[0] == 0) {
+    if (updating_mask[0] == 0 && !update_is_frozen(model, 0, 0)) {
       int position = rand() % model->numberOfSamples;
 
       if (position < NUMBER_OF_HISTORY_IMAGES)
@@ -403,3 +807,265 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
   return(0);
 }
 
+// ----------------------------------------------------------------------------
+// ------------------------ The same for 16-bit C1R models --------------------
+// ----------------------------------------------------------------------------
+
+// -----------------------------------------------------------------------------
+// Allocates and initializes a 16-bit C1R model structure
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_AllocInit_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Some basic checks. */
+  assert((image_data != NULL) && (model != NULL));
+  assert((width > 0) && (height > 0));
+
+  /* Finish model alloc - parameters values cannot be changed anymore. */
+  model->width = width;
+  model->height = height;
+
+  /* Creates the historyImage structure and the sum of the samples. */
+  model->historyImage16 = (uint16_t*)malloc(NUMBER_OF_HISTORY_IMAGES * width * height * sizeof(*(model->historyImage16)));
+  assert(model->historyImage16 != NULL);
+
+  model->historySum = (uint32_t*)malloc(width * height * sizeof(*(model->historySum)));
+  assert(model->historySum != NULL);
+
+  for (int i = 0; i < NUMBER_OF_HISTORY_IMAGES; ++i)
+    memcpy(model->historyImage16 + i * width * height, image_data, width * height * sizeof(uint16_t));
+
+  for (int index = width * height - 1; index >= 0; --index)
+    model->historySum[index] = NUMBER_OF_HISTORY_IMAGES * (uint32_t)image_data[index];
+
+  /* Fills the buffers with random values. */
+  alloc_random_buffers(model);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Segmentation of a 16-bit C1R model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Segmentation_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  uint8_t *segmentation_map
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (segmentation_map != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->historyImage16 != NULL) && (model->historySum != NULL));
+
+  /* Some variables. */
+  uint32_t count = model->width * model->height;
+  uint32_t numberOfSamples = NUMBER_OF_HISTORY_IMAGES;
+  uint32_t matchingThreshold = (model->matchingThreshold > 0xFFFF) ? 0xFFFF : model->matchingThreshold;
+  const uint32_t *historySum = model->historySum;
+  uint32_t index = 0;
+
+  /* Same decision as the 8-bit model: a pixel is foreground when it exceeds the
+     mean of its samples by more than the threshold. With the running sum,
+     floor(sum / N) + threshold < value is sum < (value - threshold) * N. */
+#ifdef __SSE2__
+  const __m128i threshold = _mm_set1_epi16((short)matchingThreshold);
+  const __m128i samples = _mm_set1_epi16((short)numberOfSamples);
+
+  for (; index + 8 <= count; index += 8) {
+    __m128i value = _mm_loadu_si128((const __m128i*)(image_data + index));
+    __m128i excess = _mm_subs_epu16(value, threshold); /* 0 when value <= threshold. */
+    __m128i low = _mm_mullo_epi16(excess, samples);
+    __m128i high = _mm_mulhi_epu16(excess, samples);
+    __m128i bound0 = _mm_unpacklo_epi16(low, high);
+    __m128i bound1 = _mm_unpackhi_epi16(low, high);
+    __m128i sum0 = _mm_loadu_si128((const __m128i*)(historySum + index));
+    __m128i sum1 = _mm_loadu_si128((const __m128i*)(historySum + index + 4));
+
+    /* Sums and bounds stay far below 2^31, so the signed comparison is safe. */
+    __m128i foreground = _mm_packs_epi32(_mm_cmplt_epi32(sum0, bound0), _mm_cmplt_epi32(sum1, bound1));
+    _mm_storel_epi64((__m128i*)(segmentation_map + index), _mm_packs_epi16(foreground, foreground));
+  }
+#endif
+
+  for (; index < count; ++index) {
+    uint32_t value = image_data[index];
+
+    segmentation_map[index] = ((value > matchingThreshold) && (historySum[index] < (value - matchingThreshold) * numberOfSamples))
+      ? COLOR_FOREGROUND : COLOR_BACKGROUND;
+  }
+
+  return(0);
+}
+
+/* Replaces one sample and keeps the sum of the samples of the pixel in sync. */
+static inline void replace_sample_16u(vibeModel_Sequential_t *model, const uint32_t index, const uint32_t position, const uint16_t value)
+{
+  uint16_t *sample = model->historyImage16 + position * model->width * model->height + index;
+
+  model->historySum[index] += (uint32_t)value - *sample;
+  *sample = value;
+}
+
+/* Hops from x to end on row y with the given jumps, and returns where the walk stopped. */
+static uint32_t update_span_16u(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  const uint8_t *updating_mask,
+  const uint32_t *jumps,
+  const uint32_t y,
+  uint32_t x,
+  const uint32_t end,
+  uint32_t *shift
+) {
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  int interiorRow = (y > 0) && (y < height - 1);
+
+  while (x < end) {
+    uint32_t index = x + y * width;
+
+    if (updating_mask[index] == COLOR_BACKGROUND) {
+      uint16_t value = image_data[index];
+      uint32_t position = model->position[*shift];
+
+      replace_sample_16u(model, index, position, value);
+
+      /* As for 8-bit models, only pixels away from the border propagate to a neighbor. */
+      if (interiorRow && (x > 0) && (x < width - 1))
+        replace_sample_16u(model, index + model->neighbor[*shift], position, value);
+    }
+
+    ++(*shift);
+    x += jumps[*shift];
+  }
+
+  return(x);
+}
+
+// ----------------------------------------------------------------------------
+// Update a 16-bit C1R model
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Update_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  uint8_t *updating_mask
+) {
+  /* Basic checks. */
+  assert((image_data != NULL) && (model != NULL) && (updating_mask != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->jump != NULL) && (model->neighbor != NULL) && (model->position != NULL));
+  assert((model->historyImage16 != NULL) && (model->historySum != NULL));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  int size = (width > height) ? 2 * width + 1 : 2 * height + 1;
+
+  for (uint32_t y = 0; y < height; ++y) {
+    uint32_t shift = rand() % width;
+
+    /* Global update factor. */
+    if (model->updateClass == NULL) {
+      update_span_16u(model, image_data, updating_mask, model->jump, y, model->jump[shift] - 1, width, &shift);
+      continue;
+    }
+
+    /* Per-block update rates, walked as in libvibeModel_Sequential_Update_8u_C1R. */
+    const uint8_t *rowClass = model->updateClass + (y / model->updateBlockSize) * model->updateBlocksPerRow;
+    uint8_t previousClass = UPDATE_CLASS_FROZEN;
+    uint32_t x = 0;
+
+    for (uint32_t block = 0; block < model->updateBlocksPerRow; ++block) {
+      uint32_t begin = block * model->updateBlockSize;
+      uint32_t end = begin + model->updateBlockSize;
+      uint8_t c = rowClass[block];
+
+      if (end > width) end = width;
+
+      if (c == UPDATE_CLASS_FROZEN) {
+        previousClass = c;
+        continue;
+      }
+
+      const uint32_t *jumpOfClass = model->jumpClass + c * size;
+
+      if ((c != previousClass) || (x < begin))
+        x = begin + (jumpOfClass[shift] >> 1);
+
+      x = update_span_16u(model, image_data, updating_mask, jumpOfClass, y, x, end, &shift);
+      previousClass = c;
+    }
+  }
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Per-block update rates of a 16-bit C1R model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_SetUpdateMap_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *update_map,
+  const uint32_t blockSize
+) {
+  /* The rates only depend on the grid, not on the samples. */
+  return(libvibeModel_Sequential_SetUpdateMap_8u_C1R(model, update_map, blockSize));
+}
+
+// -----------------------------------------------------------------------------
+// Saves a 16-bit C1R model to a snapshot file
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Save_16u_C1R(
+  const vibeModel_Sequential_t *model,
+  const char *filename
+) {
+  /* Basic checks. */
+  assert((model != NULL) && (filename != NULL));
+  assert((model->historyImage16 != NULL) && (model->jump != NULL));
+
+  size_t historySize = (size_t)NUMBER_OF_HISTORY_IMAGES * model->width * model->height;
+  return(save_snapshot(model, filename, VIBE_SNAPSHOT_16U_C1R, model->historyImage16, historySize * sizeof(uint16_t)));
+}
+
+// -----------------------------------------------------------------------------
+// Loads a 16-bit C1R model from a snapshot file
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Sequential_Load_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const char *filename,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Basic checks. */
+  assert((model != NULL) && (filename != NULL));
+  assert((width > 0) && (height > 0));
+
+  size_t historySize = (size_t)NUMBER_OF_HISTORY_IMAGES * width * height;
+  const uint8_t *history = NULL;
+  size_t fileSize = 0;
+  const uint8_t *mapped = load_snapshot(model, filename, VIBE_SNAPSHOT_16U_C1R, width, height,
+                                        historySize * sizeof(uint16_t), &history, &fileSize);
+  if (mapped == NULL)
+    return(-1);
+
+  model->historyImage16 = (uint16_t*)malloc(historySize * sizeof(*(model->historyImage16)));
+  assert(model->historyImage16 != NULL);
+  memcpy(model->historyImage16, history, historySize * sizeof(uint16_t));
+
+  munmap((void*)mapped, fileSize);
+
+  /* The sum of the samples of every pixel is not saved, it follows from the history. */
+  model->historySum = (uint32_t*)calloc((size_t)width * height, sizeof(*(model->historySum)));
+  assert(model->historySum != NULL);
+
+  for (int i = 0; i < NUMBER_OF_HISTORY_IMAGES; ++i) {
+    const uint16_t *plane = model->historyImage16 + (size_t)i * width * height;
+    for (uint32_t index = 0; index < width * height; ++index)
+      model->historySum[index] += plane[index];
+  }
+
+  return(0);
+}
@@ -158,6 +158,60 @@ int32_t libvibeModel_Sequential_AllocInit_8u_C1R(
   const uint32_t height
 );
 
+/**
+ * Sets per-block update rates, to be used instead of the global update factor
+ * by \ref libvibeModel_Sequential_Update_8u_C1R. The map holds one update factor
+ * per blockSize x blockSize block, row by row, with ceil(width / blockSize)
+ * blocks per row. Factors are rounded down to a power of two (at most 128) and
+ * a factor of 0 freezes the block: it is skipped by the update altogether.
+ * Can be called again for every frame, and with a NULL map to go back to the
+ * global update factor.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param update_map
+ * @param blockSize
+ * @return
+ */
+int32_t libvibeModel_Sequential_SetUpdateMap_8u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *update_map,
+  const uint32_t blockSize
+);
+
+/**
+ * Writes the complete state of an initialized C1R model (parameters, random
+ * buffers and history images) to a versioned binary snapshot. The snapshot is
+ * first written next to <tt>filename</tt> and then renamed, so an existing
+ * snapshot is never left truncated.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param filename
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int32_t libvibeModel_Sequential_Save_8u_C1R(
+  const vibeModel_Sequential_t *model,
+  const char *filename
+);
+
+/**
+ * Restores a C1R model saved by \ref libvibeModel_Sequential_Save_8u_C1R. The
+ * file is memory-mapped and copied into the model, which can then be used
+ * instead of calling \ref libvibeModel_Sequential_AllocInit_8u_C1R, so that a
+ * restarted stream resumes with an already converged background.
+ *
+ * @param model A structure created by \ref libvibeModel_Sequential_New.
+ * @param filename
+ * @param width Width of the stream, the snapshot must have been saved with the same one.
+ * @param height Height of the stream, the snapshot must have been saved with the same one.
+ * @return 0 on success, -1 if the file is missing, truncated or was saved for another stream or build.
+ */
+int32_t libvibeModel_Sequential_Load_8u_C1R(
+  vibeModel_Sequential_t *model,
+  const char *filename,
+  const uint32_t width,
+  const uint32_t height
+);
+
 /* These 2 functions perform 2 operations:
  *   - they classify the pixels *image_data using the provided model and store
  *     the results in *segmentation_map.
@@ -194,8 +248,105 @@ int32_t libvibeModel_Sequential_Update_8u_C1R(
 );
 
 
+// -------------------------  16-bit single channel images --------------------
+/**
+ * Same as \ref libvibeModel_Sequential_AllocInit_8u_C1R for 16-bit images,
+ * typically compressed-domain features fused in fixed point that do not fit
+ * in 8 bits. The matching threshold is expressed in the same units as the
+ * pixel values.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibeModel_Sequential_AllocInit_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ * Same decision as \ref libvibeModel_Sequential_Segmentation_8u_C1R, a pixel is
+ * foreground when it exceeds the mean of its samples by more than the matching
+ * threshold, without any wrap-around. The mean comes from a running sum kept
+ * by the update, so the cost does not depend on the number of samples.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibeModel_Sequential_Segmentation_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  uint8_t *segmentation_map
+);
+
+/**
+ * Same as \ref libvibeModel_Sequential_Update_8u_C1R for 16-bit models,
+ * per-block update rates included.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param image_data
+ * @param updating_mask
+ * @return
+ */
+int32_t libvibeModel_Sequential_Update_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint16_t *image_data,
+  uint8_t *updating_mask
+);
+
+/**
+ * Same as \ref libvibeModel_Sequential_SetUpdateMap_8u_C1R for 16-bit models,
+ * the update map itself is one byte per block for both.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param update_map
+ * @param blockSize
+ * @return
+ */
+int32_t libvibeModel_Sequential_SetUpdateMap_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const uint8_t *update_map,
+  const uint32_t blockSize
+);
+
+/**
+ * Same as \ref libvibeModel_Sequential_Save_8u_C1R for 16-bit models.
+ *
+ * @param model The data structure with ViBe's background subtraction model and parameters.
+ * @param filename
+ * @return 0 on success, -1 if the file could not be written.
+ */
+int32_t libvibeModel_Sequential_Save_16u_C1R(
+  const vibeModel_Sequential_t *model,
+  const char *filename
+);
+
+/**
+ * Restores a 16-bit model saved by \ref libvibeModel_Sequential_Save_16u_C1R,
+ * instead of calling \ref libvibeModel_Sequential_AllocInit_16u_C1R. 8-bit
+ * snapshots are rejected.
+ *
+ * @param model A structure created by \ref libvibeModel_Sequential_New.
+ * @param filename
+ * @param width Width of the stream, the snapshot must have been saved with the same one.
+ * @param height Height of the stream, the snapshot must have been saved with the same one.
+ * @return 0 on success, -1 if the file is missing, truncated or was saved for another stream, format or build.
+ */
+int32_t libvibeModel_Sequential_Load_16u_C1R(
+  vibeModel_Sequential_t *model,
+  const char *filename,
+  const uint32_t width,
+  const uint32_t height
+);
+
 #ifdef __cplusplus
 }
 #endif
 
-#endif  
+#endif
@@ -0,0 +1,321 @@
+#include <assert.h>
+#include <time.h>
+
+#include "vibe-block-sequential.h"
+
+#define NUMBER_OF_BLOCK_SAMPLES 20
+
+struct vibeModel_Block
+{
+  /* Parameters. */
+  uint32_t width;
+  uint32_t height;
+  uint32_t numberOfSamples;
+  uint32_t bitsizeThreshold;
+  uint32_t magnitudeThreshold;
+  uint32_t directionThreshold;
+  uint32_t matchingNumber;
+  uint32_t updateFactor;
+
+  /* Storage for the history, one plane per feature and per sample. */
+  uint16_t *historyBitsize;
+  uint16_t *historyMagnitude;
+  uint8_t *historyDirection;
+
+  /* Buffers with random values. */
+  uint32_t *jump;
+  int8_t *neighborX;
+  int8_t *neighborY;
+  uint32_t *position;
+};
+
+static inline uint32_t abs_diff_16u(const uint16_t a, const uint16_t b)
+{
+  return (a > b) ? a - b : b - a;
+}
+
+/* Number of sectors between two directions among the 8 sectors of the circle. */
+static inline uint32_t direction_distance(const uint8_t a, const uint8_t b)
+{
+  uint32_t d = (a > b) ? a - b : b - a;
+  return (d > 4) ? 8 - d : d;
+}
+
+// -----------------------------------------------------------------------------
+// Print parameters
+// -----------------------------------------------------------------------------
+uint32_t libvibeModel_Block_PrintParameters(const vibeModel_Block_t *model)
+{
+  assert(model != NULL);
+
+  printf(
+    "Using block-grid ViBe background subtraction algorithm\n"
+      "  - Number of samples per block:       %03d\n"
+      "  - Number of matches needed:          %03d\n"
+      "  - Bitsize threshold:                 %03d\n"
+      "  - Motion vector length threshold:   %03d\n"
+      "  - Direction threshold (sectors):     %03d\n"
+      "  - Model update subsampling factor:   %03d\n",
+    model->numberOfSamples,
+    model->matchingNumber,
+    model->bitsizeThreshold,
+    model->magnitudeThreshold,
+    model->directionThreshold,
+    model->updateFactor
+  );
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Creates the data structure
+// -----------------------------------------------------------------------------
+vibeModel_Block_t *libvibeModel_Block_New()
+{
+  /* Model structure alloc. */
+  vibeModel_Block_t *model = NULL;
+  model = (vibeModel_Block_t*)calloc(1, sizeof(*model));
+  assert(model != NULL);
+
+  /* Default parameters values. */
+  model->numberOfSamples    = NUMBER_OF_BLOCK_SAMPLES;
+  model->bitsizeThreshold   = 32;
+  model->magnitudeThreshold = 4;
+  model->directionThreshold = 1;
+  model->matchingNumber     = 2;
+  model->updateFactor       = 16;
+
+  return(model);
+}
+
+// -----------------------------------------------------------------------------
+// Some "Set-ers"
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Block_SetThresholds(
+  vibeModel_Block_t *model,
+  const uint32_t bitsizeThreshold,
+  const uint32_t magnitudeThreshold,
+  const uint32_t directionThreshold
+) {
+  assert(model != NULL);
+  assert(directionThreshold <= 4);
+
+  model->bitsizeThreshold = bitsizeThreshold;
+  model->magnitudeThreshold = magnitudeThreshold;
+  model->directionThreshold = directionThreshold;
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Block_SetMatchingNumber(
+  vibeModel_Block_t *model,
+  const uint32_t matchingNumber
+) {
+  assert(model != NULL);
+  assert((matchingNumber > 0) && (matchingNumber <= model->numberOfSamples));
+
+  model->matchingNumber = matchingNumber;
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Block_SetUpdateFactor(
+  vibeModel_Block_t *model,
+  const uint32_t updateFactor
+) {
+  assert(model != NULL);
+  assert(updateFactor > 0);
+  assert(model->jump == NULL);
+
+  model->updateFactor = updateFactor;
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// Frees the structure
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Block_Free(vibeModel_Block_t *model)
+{
+  if (model == NULL)
+    return(-1);
+
+  free(model->historyBitsize);
+  free(model->historyMagnitude);
+  free(model->historyDirection);
+  free(model->jump);
+  free(model->neighborX);
+  free(model->neighborY);
+  free(model->position);
+  free(model);
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Allocates and initializes the model
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Block_AllocInit(
+  vibeModel_Block_t *model,
+  const vibeBlockFeatures_t *features,
+  const uint32_t width,
+  const uint32_t height
+) {
+  /* Some basic checks. */
+  assert((features != NULL) && (model != NULL));
+  assert((features->bitsize != NULL) && (features->magnitude != NULL) && (features->direction != NULL));
+  assert((width > 0) && (height > 0));
+
+  model->width = width;
+  model->height = height;
+
+  /* Creates the history planes, every sample starts as the first frame. */
+  uint32_t blocks = width * height;
+
+  model->historyBitsize = (uint16_t*)malloc(model->numberOfSamples * blocks * sizeof(uint16_t));
+  assert(model->historyBitsize != NULL);
+
+  model->historyMagnitude = (uint16_t*)malloc(model->numberOfSamples * blocks * sizeof(uint16_t));
+  assert(model->historyMagnitude != NULL);
+
+  model->historyDirection = (uint8_t*)malloc(model->numberOfSamples * blocks * sizeof(uint8_t));
+  assert(model->historyDirection != NULL);
+
+  for (uint32_t i = 0; i < model->numberOfSamples; ++i) {
+    memcpy(model->historyBitsize + i * blocks, features->bitsize, blocks * sizeof(uint16_t));
+    memcpy(model->historyMagnitude + i * blocks, features->magnitude, blocks * sizeof(uint16_t));
+    memcpy(model->historyDirection + i * blocks, features->direction, blocks * sizeof(uint8_t));
+  }
+
+  /* Fills the buffers with random values. */
+  int size = (width > height) ? 2 * width + 1 : 2 * height + 1;
+
+  model->jump = (uint32_t*)malloc(size * sizeof(*(model->jump)));
+  assert(model->jump != NULL);
+
+  model->neighborX = (int8_t*)malloc(size * sizeof(*(model->neighborX)));
+  assert(model->neighborX != NULL);
+
+  model->neighborY = (int8_t*)malloc(size * sizeof(*(model->neighborY)));
+  assert(model->neighborY != NULL);
+
+  model->position = (uint32_t*)malloc(size * sizeof(*(model->position)));
+  assert(model->position != NULL);
+
+  for (int i = 0; i < size; ++i) {
+    model->jump[i] = (model->updateFactor == 1) ? 1 : (rand() % (2 * model->updateFactor)) + 1; // 1 or values between 1 and 2 * updateFactor.
+    model->neighborX[i] = (rand() % 3) - 1;                               // Values between -1 and 1.
+    model->neighborY[i] = (rand() % 3) - 1;                               // Values between -1 and 1.
+    model->position[i] = rand() % (model->numberOfSamples);               // Values between 0 and numberOfSamples - 1.
+  }
+
+  return(0);
+}
+
+// -----------------------------------------------------------------------------
+// Segmentation
+// -----------------------------------------------------------------------------
+int32_t libvibeModel_Block_Segmentation(
+  vibeModel_Block_t *model,
+  const vibeBlockFeatures_t *features,
+  uint8_t *segmentation_map
+) {
+  /* Basic checks. */
+  assert((features != NULL) && (model != NULL) && (segmentation_map != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert(model->historyBitsize != NULL);
+
+  /* Some variables. */
+  uint32_t blocks = model->width * model->height;
+  uint32_t bitsizeThreshold = model->bitsizeThreshold;
+  uint32_t magnitudeThreshold = model->magnitudeThreshold;
+  uint32_t directionThreshold = model->directionThreshold;
+
+  const uint16_t *bitsize = features->bitsize;
+  const uint16_t *magnitude = features->magnitude;
+  const uint8_t *direction = features->direction;
+
+  /* The map counts the matches, then becomes the output. */
+  memset(segmentation_map, 0, blocks);
+
+  for (uint32_t i = 0; i < model->numberOfSamples; ++i) {
+    const uint16_t *sampleBitsize = model->historyBitsize + i * blocks;
+    const uint16_t *sampleMagnitude = model->historyMagnitude + i * blocks;
+    const uint8_t *sampleDirection = model->historyDirection + i * blocks;
+
+    for (uint32_t index = 0; index < blocks; ++index) {
+      /* Directions only make sense when both blocks really move. */
+      uint32_t moving = (magnitude[index] > magnitudeThreshold) & (sampleMagnitude[index] > magnitudeThreshold);
+
+      segmentation_map[index] +=
+        (abs_diff_16u(bitsize[index], sampleBitsize[index]) <= bitsizeThreshold) &
+        (abs_diff_16u(magnitude[index], sampleMagnitude[index]) <= magnitudeThreshold) &
+        (!moving | (direction_distance(direction[index], sampleDirection[index]) <= directionThreshold));
+    }
+  }
+
+  /* Produces the output. */
+  for (uint32_t index = 0; index < blocks; ++index)
+    segmentation_map[index] = (segmentation_map[index] < model->matchingNumber) ? COLOR_FOREGROUND : COLOR_BACKGROUND;
+
+  return(0);
+}
+
+// ----------------------------------------------------------------------------
+// Update
+// ----------------------------------------------------------------------------
+int32_t libvibeModel_Block_Update(
+  vibeModel_Block_t *model,
+  const vibeBlockFeatures_t *features,
+  uint8_t *updating_mask
+) {
+  /* Basic checks. */
+  assert((features != NULL) && (model != NULL) && (updating_mask != NULL));
+  assert((model->width > 0) && (model->height > 0));
+  assert((model->jump != NULL) && (model->neighborX != NULL) && (model->position != NULL));
+
+  /* Some variables. */
+  uint32_t width = model->width;
+  uint32_t height = model->height;
+  uint32_t blocks = width * height;
+
+  uint32_t *jump = model->jump;
+  int8_t *neighborX = model->neighborX;
+  int8_t *neighborY = model->neighborY;
+  uint32_t *position = model->position;
+
+  /* The grid is small, so the borders simply clip the neighbor instead of having their own loops. */
+  for (uint32_t y = 0; y < height; ++y) {
+    uint32_t shift = rand() % width;
+    uint32_t x = jump[shift] - 1;
+
+    while (x < width) {
+      uint32_t index = x + y * width;
+
+      if (updating_mask[index] == COLOR_BACKGROUND) {
+        uint32_t offset = position[shift] * blocks;
+        int nx = (int)x + neighborX[shift];
+        int ny = (int)y + neighborY[shift];
+
+        model->historyBitsize[offset + index] = features->bitsize[index];
+        model->historyMagnitude[offset + index] = features->magnitude[index];
+        model->historyDirection[offset + index] = features->direction[index];
+
+        if ((nx >= 0) && (ny >= 0) && (nx < (int)width) && (ny < (int)height)) {
+          uint32_t index_neighbor = nx + ny * width;
+
+          model->historyBitsize[offset + index_neighbor] = features->bitsize[index];
+          model->historyMagnitude[offset + index_neighbor] = features->magnitude[index];
+          model->historyDirection[offset + index_neighbor] = features->direction[index];
+        }
+      }
+
+      ++shift;
+      x += jump[shift];
+    }
+  }
+
+  return(0);
+}
@@ -0,0 +1,158 @@
+#ifndef _VIBE_BLOCK_SEQUENTIAL_H_
+#define _VIBE_BLOCK_SEQUENTIAL_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef COLOR_BACKGROUND
+#define COLOR_BACKGROUND   0 /*!< Default label for background blocks */
+#endif
+#ifndef COLOR_FOREGROUND
+#define COLOR_FOREGROUND 255 /*!< Default label for foreground blocks */
+#endif
+
+/**
+ * \typedef struct vibeModel_Block_t
+ * \brief Background model working directly on the block grid of a compressed stream.
+ *
+ * Instead of fusing the compressed-domain features into one 8-bit pixel, every
+ * sample of this model keeps the three features of a block separately and each
+ * feature has its own matching threshold.
+ */
+typedef struct vibeModel_Block vibeModel_Block_t;
+
+/**
+ * \brief One frame of block features, stored as three planes of width * height blocks.
+ *
+ * The grid is whatever the caller works on (4x4 partitions or 16x16 macroblocks),
+ * the model only requires all planes to share it.
+ */
+typedef struct
+{
+  const uint16_t *bitsize;   /*!< Bits spent to code the block. */
+  const uint16_t *magnitude; /*!< Length of the motion vector of the block. */
+  const uint8_t *direction;  /*!< 0 without motion, 1 to 8 for the sector of the motion vector. */
+} vibeBlockFeatures_t;
+
+/**
+ * Allocation of a new data structure where the block model will be stored.
+ * The buffers are only allocated by \ref libvibeModel_Block_AllocInit.
+ *
+ * \result A pointer to a newly allocated \ref vibeModel_Block_t structure.
+ */
+vibeModel_Block_t *libvibeModel_Block_New();
+
+/**
+ * Prints the parameters of the model.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @return
+ */
+uint32_t libvibeModel_Block_PrintParameters(const vibeModel_Block_t *model);
+
+/**
+ * Setter. A sample matches a block when all three features are within their threshold.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @param bitsizeThreshold Largest bitsize difference of a match.
+ * @param magnitudeThreshold Largest motion vector length difference of a match.
+ * @param directionThreshold Largest number of sectors between the two directions of a match. The
+ * directions are only compared when both motion vectors are longer than magnitudeThreshold.
+ * @return
+ */
+int32_t libvibeModel_Block_SetThresholds(
+  vibeModel_Block_t *model,
+  const uint32_t bitsizeThreshold,
+  const uint32_t magnitudeThreshold,
+  const uint32_t directionThreshold
+);
+
+/**
+ * Setter.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @param matchingNumber
+ * @return
+ */
+int32_t libvibeModel_Block_SetMatchingNumber(
+  vibeModel_Block_t *model,
+  const uint32_t matchingNumber
+);
+
+/**
+ * Setter. Must be called before \ref libvibeModel_Block_AllocInit.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @param updateFactor 1 out of updateFactor background blocks is updated.
+ * @return
+ */
+int32_t libvibeModel_Block_SetUpdateFactor(
+  vibeModel_Block_t *model,
+  const uint32_t updateFactor
+);
+
+/**
+ * \brief Frees all the memory used by the <tt>model</tt> and deallocates the structure.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @return
+ */
+int32_t libvibeModel_Block_Free(vibeModel_Block_t *model);
+
+/**
+ * Allocates the model for a grid of width * height blocks and initializes all
+ * its samples with the features of the first frame.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @param features
+ * @param width
+ * @param height
+ * @return
+ */
+int32_t libvibeModel_Block_AllocInit(
+  vibeModel_Block_t *model,
+  const vibeBlockFeatures_t *features,
+  const uint32_t width,
+  const uint32_t height
+);
+
+/**
+ * Classifies the blocks of <tt>features</tt> into *segmentation_map, one byte per block.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @param features
+ * @param segmentation_map
+ * @return
+ */
+int32_t libvibeModel_Block_Segmentation(
+  vibeModel_Block_t *model,
+  const vibeBlockFeatures_t *features,
+  uint8_t *segmentation_map
+);
+
+/**
+ * Updates the samples of the background blocks of *updating_mask.
+ *
+ * @param model The data structure with the block model and parameters.
+ * @param features
+ * @param updating_mask
+ * @return
+ */
+int32_t libvibeModel_Block_Update(
+  vibeModel_Block_t *model,
+  const vibeBlockFeatures_t *features,
+  uint8_t *updating_mask
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif